@@ -21,17 +21,12 @@ import re
 import pprint
 
 data = []
-ranges = []
 
 template_main="""// This is a generated file. See emoji.py for details
 // clang-format off
 static std::vector<EmojiRegistry::Group> db = {{{groups}
 }};
 
-static std::map<quint32, quint32> ranges = {{
-    {ranges}
-}};
-
 // clang-format on
 """
 
@@ -79,23 +74,6 @@ def parse(f):
             subgroup["emojis"].append((code, desc[0].strip()))
 
 
-def generate_ranges():
-    emojis=[]
-    for g in data:
-        for sg in g["subgroups"]:
-            emojis += sg["emojis"]
-    emojis = sorted(emojis)
-    cur_code = range_start = 0
-    for emoji in emojis:
-        new_code = ord(emoji[0][0])
-        if new_code != cur_code and new_code != cur_code + 1:
-            if range_start != 0:
-                ranges.append((range_start, cur_code))
-            range_start = new_code
-        cur_code = new_code
-    ranges.append((range_start, cur_code))
-
-
 def generate_cpp_db():
     print(template_main.format(groups=",".join([
         template_group.format(name=group["name"], subgroups=",".join([
@@ -106,12 +84,11 @@ def generate_cpp_db():
             for sub in group["subgroups"]
         ]))
         for group in data
-    ]), ranges=",\n    ".join([f"{{{r[0]}, {r[1]}}}" for r in ranges])))
+    ])))
 
 
 # https://unicode.org/Public/emoji/13.0/emoji-test.txt
 with open("emoji-test.txt") as f:
     reset()
     parse(f)
-    generate_ranges()
     generate_cpp_db()
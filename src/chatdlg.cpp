@@ -31,11 +31,13 @@
 #include "iconselect.h"
 #include "iconwidget.h"
 #include "jidutil.h"
+#include "messageformatter.h"
 #include "msgmle.h"
 #include "pgputil.h"
 #ifdef PSI_PLUGINS
 #include "pluginmanager.h"
 #endif
+#include "profiles.h"
 #include "psiaccount.h"
 #include "psichatdlg.h"
 #include "psicon.h"
@@ -106,6 +108,9 @@ ChatDlg::ChatDlg(const Jid &jid, PsiAccount *pa, TabManager *tabManager) :
 
     status_ = -1;
 
+    formatter_ = new MessageFormatter(this);
+    connect(formatter_, &MessageFormatter::ready, this, &ChatDlg::messageFormatted);
+
     if (!pa->findGCContact(jid) || ((pa->edb()->features() & EDB::PrivateContacts) != 0)) {
         historyState = false;
         preloadHistory();
@@ -149,6 +154,16 @@ void ChatDlg::init()
     chatView()->setMediaOpener(account()->fileSharingDeviceOpener());
 #endif
     chatView()->init();
+#ifndef WEBKIT
+    connect(chatView(), &ChatView::olderMessagesRequested, this, &ChatDlg::requestOlderHistory);
+#endif
+    // the view of a logged chat can leave messages to the history and load them back
+    bool logged = account()->userAccount().opt_log
+        && (!account()->findGCContact(jid())
+            || (PsiOptions::instance()->getOption("options.history.store-muc-private").toBool()
+                && (account()->edb()->features() & EDB::PrivateContacts) != 0));
+    chatView()->setHistoryAvailable(logged);
+    connect(chatView(), &ChatView::spilledMessagesRequested, this, &ChatDlg::requestSpilledHistory);
 
     // seems its useless hack
     // connect(chatView(), SIGNAL(selectionChanged()), SLOT(logSelectionChanged())); //
@@ -454,6 +469,104 @@ void ChatDlg::getHistory()
     holdMessages(false);
 }
 
+/**
+ * Loads back from the history the messages dropped from the top of the chat view.
+ * The history keeps seconds only, so everything up to the end of the \a oldest message's second
+ * is fetched, and the \a shownAtOldest messages of that second still in the view are skipped.
+ */
+void ChatDlg::requestOlderHistory(const QDateTime &oldest, int count, int shownAtOldest)
+{
+    olderOldest_ = oldest;
+    olderSkip_   = shownAtOldest;
+
+    EDBHandle *h = new EDBHandle(account()->edb());
+    connect(h, SIGNAL(finished()), this, SLOT(getOlderHistory()));
+    Jid j = jid();
+    if (!account()->findGCContact(j))
+        j = jid().bare();
+    const QDateTime nextSecond
+        = QDateTime::fromMSecsSinceEpoch((oldest.toMSecsSinceEpoch() / 1000 + 1) * 1000, oldest.timeSpec());
+    h->get(account()->id(), j, nextSecond, EDB::Backward, 0, count + shownAtOldest);
+}
+
+void ChatDlg::getOlderHistory()
+{
+    EDBHandle *h = qobject_cast<EDBHandle *>(sender());
+    if (!h)
+        return;
+
+    QList<MessageView> messages = historyMessages(h, olderOldest_, olderSkip_);
+    for (MessageView &mv : messages)
+        mv.setSpooled(true);
+    delete h;
+    chatView()->prependMessages(messages);
+}
+
+/**
+ * Loads back from the history the messages the chat view didn't keep while it was hidden.
+ * Everything up to the end of the \a newest message's second is fetched, and the \a heldAtNewest
+ * messages of that second which came later and are still held by the view are skipped.
+ */
+void ChatDlg::requestSpilledHistory(const QDateTime &newest, int count, int heldAtNewest)
+{
+    spilledNewest_ = newest;
+    spilledSkip_   = heldAtNewest;
+
+    EDBHandle *h = new EDBHandle(account()->edb());
+    connect(h, SIGNAL(finished()), this, SLOT(getSpilledHistory()));
+    Jid j = jid();
+    if (!account()->findGCContact(j))
+        j = jid().bare();
+    const QDateTime nextSecond
+        = QDateTime::fromMSecsSinceEpoch((newest.toMSecsSinceEpoch() / 1000 + 1) * 1000, newest.timeSpec());
+    h->get(account()->id(), j, nextSecond, EDB::Backward, 0, count + heldAtNewest);
+}
+
+void ChatDlg::getSpilledHistory()
+{
+    EDBHandle *h = qobject_cast<EDBHandle *>(sender());
+    if (!h)
+        return;
+
+    QList<MessageView> messages = historyMessages(h, spilledNewest_, spilledSkip_);
+    delete h;
+    chatView()->restoreSpilledMessages(messages);
+}
+
+/**
+ * Makes views of the messages of a backward history request to the end of the \a newest message's second,
+ * oldest first. Up to \a skip messages of that second coming first in the result (the newest ones) are left out.
+ */
+QList<MessageView> ChatDlg::historyMessages(const EDBHandle *h, const QDateTime &newest, int skip) const
+{
+    const EDBResult &r      = h->result();
+    const qint64     second = newest.toMSecsSinceEpoch() / 1000;
+    int              first  = 0;
+    while (first < r.count() && first < skip && r.at(first)->event()->timeStamp().toMSecsSinceEpoch() / 1000 == second)
+        ++first;
+
+    QList<MessageView> messages;
+    for (int i = r.count() - 1; i >= first; --i) {
+        PsiEvent::Ptr e = r.at(i)->event();
+        if (e->type() != PsiEvent::Message)
+            continue;
+
+        MessageEvent::Ptr me = e.staticCast<MessageEvent>();
+        const Message &   m  = me->message();
+        MessageView       mv(MessageView::Message);
+        if (PsiOptions::instance()->getOption("options.html.chat.render").toBool() && m.containsHTML()
+            && !m.html().body().firstChild().isNull()) {
+            mv.setHtml(m.html().toString("span"));
+        } else {
+            mv.setPlainText(m.body());
+        }
+        initMessageView(mv, m, me->originLocal());
+        mv.setAwaitingReceipt(false);
+        messages.append(mv);
+    }
+    return messages;
+}
+
 void ChatDlg::ensureTabbedCorrectly()
 {
     TabbableWidget::ensureTabbedCorrectly();
@@ -602,7 +715,11 @@ void ChatDlg::doHistory() { emit aHistory(jid()); }
 
 void ChatDlg::doFile() { emit aFile(jid()); }
 
-void ChatDlg::doClear() { chatView()->clear(); }
+void ChatDlg::doClear()
+{
+    formatter_->clear();
+    chatView()->clear();
+}
 
 QString ChatDlg::desiredCaption() const
 {
@@ -789,7 +906,7 @@ void ChatDlg::incomingMessage(const Message &m)
         if (m.chatState() != XMPP::StateNone) {
             setContactChatState(m.chatState());
         }
-        if (m.messageReceipt() == ReceiptReceived) {
+        if (m.messageReceipt() == ReceiptReceived && !formatter_->markReceived(m.messageReceiptId())) {
             chatView()->markReceived(m.messageReceiptId());
         }
     } else {
@@ -886,18 +1003,9 @@ void ChatDlg::appendMessage(const Message &m, bool local)
         && !htmlElem.body().firstChild().isNull()) {
         mv.setHtml(htmlElem.toString("span"));
     } else {
-        mv.setPlainText(body);
+        mv.deferPlainText(body);
     }
-    mv.setMessageId(m.id());
-    mv.setLocal(local);
-    mv.setNick(whoNick(local));
-    mv.setUserId(local ? account()->jid().full()
-                       : jid().full()); // theoretically, this can be inferred from the chat dialog properties
-    mv.setDateTime(m.timeStamp());
-    mv.setSpooled(historyState);
-    mv.setAwaitingReceipt(local && m.messageReceipt() == ReceiptRequest);
-    mv.setReplaceId(m.replaceId());
-    mv.setCarbonDirection(m.carbonDirection());
+    initMessageView(mv, m, local);
     account()->psi()->fileSharingManager()->fillMessageView(mv, m, account());
 
     dispatchMessage(mv);
@@ -919,6 +1027,20 @@ void ChatDlg::appendMessage(const Message &m, bool local)
     emit messageAppended(body, chatView()->textWidget());
 }
 
+void ChatDlg::initMessageView(MessageView &mv, const Message &m, bool local) const
+{
+    mv.setMessageId(m.id());
+    mv.setLocal(local);
+    mv.setNick(whoNick(local));
+    mv.setUserId(local ? account()->jid().full()
+                       : jid().full()); // theoretically, this can be inferred from the chat dialog properties
+    mv.setDateTime(m.timeStamp());
+    mv.setSpooled(historyState);
+    mv.setAwaitingReceipt(local && m.messageReceipt() == ReceiptRequest);
+    mv.setReplaceId(m.replaceId());
+    mv.setCarbonDirection(m.carbonDirection());
+}
+
 void ChatDlg::holdMessages(bool hold)
 {
     if (hold) {
@@ -938,7 +1060,10 @@ void ChatDlg::holdMessages(bool hold)
     }
 }
 
-void ChatDlg::dispatchMessage(const MessageView &mv)
+void ChatDlg::dispatchMessage(const MessageView &mv) { formatter_->append(mv); }
+
+// messages come here in the order of dispatchMessage() when they are ready to be displayed
+void ChatDlg::messageFormatted(const MessageView &mv)
 {
     if (delayedMessages)
         delayedMessages->append(mv);
@@ -35,7 +35,9 @@
 
 class ChatEdit;
 class ChatView;
+class EDBHandle;
 class FileSharingItem;
+class MessageFormatter;
 class PsiAccount;
 class QDragEnterEvent;
 class QDropEvent;
@@ -146,6 +148,10 @@ private slots:
     void         initComposing();
     void         setComposing();
     void         getHistory();
+    void         requestOlderHistory(const QDateTime &oldest, int count, int shownAtOldest);
+    void         getOlderHistory();
+    void         requestSpilledHistory(const QDateTime &newest, int count, int heldAtNewest);
+    void         getSpilledHistory();
 
 protected slots:
     void checkComposing();
@@ -158,7 +164,10 @@ protected:
     void         resetComposing();
     void         doneSend();
     void         holdMessages(bool hold);
+    void         messageFormatted(const MessageView &mv);
     void         displayMessage(const MessageView &mv);
+    void         initMessageView(MessageView &mv, const Message &m, bool local) const;
+    QList<MessageView> historyMessages(const EDBHandle *h, const QDateTime &newest, int skip) const;
     virtual void setLooks();
     virtual void chatEditCreated();
     void         initHighlighters();
@@ -216,6 +225,11 @@ private:
     ChatState           contactChatState_;
     ChatState           lastChatState_;
     QList<MessageView> *delayedMessages;
+    MessageFormatter *  formatter_;
+    QDateTime           olderOldest_; // see requestOlderHistory()
+    int                 olderSkip_ = 0;
+    QDateTime           spilledNewest_; // see requestSpilledHistory()
+    int                 spilledSkip_ = 0;
 
     QList<Reference> fileShareReferences_;
     QString          fileShareDesc_;
@@ -48,6 +48,7 @@
 static const char *  informationalColorOpt = "options.ui.look.colors.messages.informational";
 static const QRegExp underlineFixRE("(<a href=\"addnick://psi/[^\"]*\"><span style=\")");
 static const QRegExp removeTagsRE("<[^>]*>");
+static const int     historyPageSize = 50; // messages loaded back from the history per scroll to top
 
 //----------------------------------------------------------------------------
 // ChatView
@@ -72,6 +73,7 @@ ChatView::ChatView(QWidget *parent) :
     addAction(actQuote_);
     connect(actQuote_, &QAction::triggered, this, [this](bool) { emit quote(getPlainText()); });
     connect(this, &ChatView::selectionChanged, this, [this]() { actQuote_->setEnabled(textCursor().hasSelection()); });
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &ChatView::checkScrollback);
 
     addLogIconsResources();
 }
@@ -97,6 +99,13 @@ void ChatView::setSessionData(bool isMuc, bool isMucPrivate, const XMPP::Jid &ji
 
 void ChatView::clear()
 {
+    endBatch();
+    clearHeldMessages();
+    messages_.clear();
+    markers_.clear();
+    markersShift_    = 0;
+    trimmedMessages_ = 0;
+    olderRequested_  = false;
     PsiTextView::clear();
     addLogIconsResources();
 }
@@ -147,9 +156,11 @@ void ChatView::addLogIconsResources()
     for (auto &i : icons) {
         auto res = QUrl(QLatin1String("icon:") + i.name);
         if (useMessageIcons_) {
-            auto icon = IconsetFactory::iconPixmap(i.icon, scaledSize);
-            if (icon.height() > HugeIconTextViewK * fs || scale) {
-                icon = icon.scaledToHeight(scaledSize, Qt::SmoothTransformation);
+            auto  icon = IconsetFactory::iconPixmap(i.icon, scaledSize);
+            qreal dpr  = icon.devicePixelRatio();
+            if (icon.height() > HugeIconTextViewK * fs * dpr || scale) {
+                icon = icon.scaledToHeight(qRound(scaledSize * dpr), Qt::SmoothTransformation);
+                icon.setDevicePixelRatio(dpr);
             }
             document()->addResource(QTextDocument::ImageResource, res, icon);
         } else {
@@ -160,6 +171,9 @@ void ChatView::addLogIconsResources()
 
 void ChatView::markReceived(QString id)
 {
+    if (markHeldMessageReceived(id)) {
+        return;
+    }
     if (useMessageIcons_) {
         auto delivered = document()->resource(
             QTextDocument::ImageResource,
@@ -172,6 +186,46 @@ void ChatView::markReceived(QString id)
 
 bool ChatView::focusNextPrevChild(bool next) { return QWidget::focusNextPrevChild(next); }
 
+void ChatView::showEvent(QShowEvent *e)
+{
+    PsiTextView::showEvent(e);
+    flushHeldMessages();
+}
+
+/**
+ * Renders messages received while the view was hidden. If some of them were left to the history,
+ * they are requested first and everything goes out in restoreSpilledMessages()
+ */
+void ChatView::flushHeldMessages()
+{
+    if (isRestoringSpilled()) {
+        return;
+    }
+
+    QDateTime newest;
+    int       count, heldAtNewest;
+    if (takeSpilledRange(&newest, &count, &heldAtNewest)) {
+        emit spilledMessagesRequested(newest, count, heldAtNewest);
+        return;
+    }
+
+    const auto held = takeHeldMessages();
+    for (const MessageView &mv : held) {
+        dispatchMessage(mv);
+    }
+}
+
+/**
+ * Called in reply to spilledMessagesRequested() with the \a messages loaded back from the history, oldest first
+ */
+void ChatView::restoreSpilledMessages(const QList<MessageView> &messages)
+{
+    const auto held = takeHeldMessages(messages);
+    for (const MessageView &mv : held) {
+        dispatchMessage(mv);
+    }
+}
+
 void ChatView::keyPressEvent(QKeyEvent *e)
 {
     /*    if(e->key() == Qt::Key_Escape)
@@ -252,6 +306,16 @@ QString ChatView::colorString(bool local, bool spooled) const
 
 void ChatView::insertText(const QString &text, QTextCursor &insertCursor)
 {
+    if (!batchCursor_.isNull()) {
+        // scrolling is settled once for the whole batch in endBatch()
+        if (insertCursor.isNull()) {
+            PsiTextView::appendText(text);
+        } else {
+            PsiTextView::insertText(text, insertCursor);
+        }
+        return;
+    }
+
     bool doScrollToBottom = atBottom();
 
     // prevent scrolling back to selected text when
@@ -278,27 +342,26 @@ void ChatView::appendText(const QString &text)
 
 void ChatView::dispatchMessage(const MessageView &mv)
 {
+    if (holdHiddenMessage(this, mv)) {
+        return;
+    }
+    beginBatch();
+
     const QString &replaceId = mv.replaceId();
     if ((mv.type() == MessageView::Message || mv.type() == MessageView::Subject)
         && ChatViewCommon::updateLastMsgTime(mv.dateTime()) && replaceId.isEmpty()) {
-        QString color = ColorOpt::instance()->color(informationalColorOpt).name();
-        appendText(
-            QString(useMessageIcons_ ? "<img src=\"icon:log_icon_time\" />" : "")
-            + QString("<font color=\"%1\">*** %2</font>").arg(color, mv.dateTime().date().toString(Qt::ISODate)));
+        appendText(dateSeparator(mv.dateTime().date()));
     }
 
     switch (mv.type()) {
     case MessageView::Message: {
-        int         scrollPos      = verticalScrollBar()->value();
-        bool        doScrollBottom = atBottom();
-        bool        isReplace      = !replaceId.isEmpty();
+        bool        isReplace = !replaceId.isEmpty();
         QTextCursor cursor         = textCursor(), replaceCursor;
         auto        sel            = PsiRichText::saveSelection(this, cursor);
         cursor.clearSelection();
         setTextCursor(cursor);
         if (isReplace) {
-            cursor.setPosition(0);
-            replaceCursor = PsiRichText::findMarker(cursor, replaceId + "_" + mv.userId());
+            replaceCursor = findMessageMarker(replaceId + "_" + mv.userId());
             isReplace     = !replaceCursor.isNull(); // marker not found
         }
         if (isReplace) {
@@ -317,7 +380,18 @@ void ChatView::dispatchMessage(const MessageView &mv)
         } else {
             cursor.movePosition(QTextCursor::End); // no luck with replace, then insert into the end of doc
         }
-        PsiRichText::insertMarker(cursor, mv.messageId() + "_" + mv.userId());
+        if (isReplace) {
+            // the old marker is gone with the replaced text
+            const QString oldId = replaceId + "_" + mv.userId();
+            markers_.remove(oldId);
+            for (int i = messages_.size() - 1; i >= 0; --i) {
+                if (messages_[i].markerId == oldId) {
+                    messages_[i].markerId = mv.messageId() + "_" + mv.userId();
+                    break;
+                }
+            }
+        }
+        insertMessageMarker(cursor, mv.messageId() + "_" + mv.userId());
         setTextCursor(cursor); // make sure the message is rendered here and nowhere else
         if (isMuc_) {
             renderMucMessage(mv, cursor);
@@ -335,15 +409,11 @@ void ChatView::dispatchMessage(const MessageView &mv)
         } else {
             // qDebug("end marker at %d", cursor.position());
             PsiRichText::insertMarker(cursor, QString()); // end marker
+            messages_.append({ mv.messageId() + "_" + mv.userId(), mv.dateTime() });
         }
         cursor.movePosition(QTextCursor::End); // ensure everything else is inserted into the end
         PsiRichText::restoreSelection(this, cursor, sel);
         setTextCursor(cursor);
-        if (doScrollBottom) {
-            scrollToBottom();
-        } else {
-            verticalScrollBar()->setValue(scrollPos);
-        }
         break;
     }
     case MessageView::Subject:
@@ -365,11 +435,217 @@ void ChatView::dispatchMessage(const MessageView &mv)
     }
 }
 
+/**
+ * Starts coalescing the document changes into one edit block, so the document
+ * is laid out and the view is scrolled once per event loop turn instead of once
+ * per appended message. The block is closed by endBatch() queued here.
+ */
+void ChatView::beginBatch()
+{
+    if (!batchCursor_.isNull()) {
+        return;
+    }
+    batchAtBottom_  = atBottom();
+    batchScrollPos_ = verticalScrollBar()->value();
+    batchCursor_    = QTextCursor(document());
+    batchCursor_.beginEditBlock();
+    QMetaObject::invokeMethod(this, "endBatch", Qt::QueuedConnection);
+}
+
+/**
+ * Closes the edit block opened by beginBatch() and scrolls the view.
+ * Anything which depends on the geometry of the document has to call it first.
+ */
+void ChatView::endBatch()
+{
+    if (batchCursor_.isNull()) {
+        return;
+    }
+    if (batchAtBottom_) {
+        trimScrollback(); // don't pull the text from under the user reading the backlog
+    }
+    batchCursor_.endEditBlock();
+    batchCursor_ = QTextCursor();
+    if (batchAtBottom_) {
+        scrollToBottom();
+    } else {
+        verticalScrollBar()->setValue(batchScrollPos_);
+    }
+}
+
+/**
+ * Inserts \a messages (oldest first) loaded from the history above
+ * everything shown, keeping the visible part of the view in place.
+ * Called in reply to olderMessagesRequested(), even with an empty list.
+ */
+void ChatView::prependMessages(const QList<MessageView> &messages)
+{
+    endBatch();
+    olderRequested_ = false;
+    if (messages.isEmpty()) {
+        trimmedMessages_ = 0; // nothing older in the history
+        return;
+    }
+    trimmedMessages_ = qMax(0, trimmedMessages_ - messages.size());
+
+    QScrollBar *sb         = verticalScrollBar();
+    int         fromBottom = sb->maximum() - sb->value();
+    int         oldLength  = document()->characterCount();
+
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    cursor.insertBlock(); // room for the first message
+    cursor.setPosition(0);
+    QDate                      lastDate;
+    QList<QPair<QString, int>> newMarkers; // indexed once the shift of the old ones is known
+    for (int i = 0; i < messages.size(); ++i) {
+        const MessageView &mv = messages.at(i);
+        if (i) {
+            cursor.insertBlock();
+        }
+        // the same separators dispatchMessage() puts between the days
+        if (mv.dateTime().date() != lastDate) {
+            lastDate = mv.dateTime().date();
+            cursor.insertHtml(dateSeparator(lastDate));
+            cursor.insertBlock();
+        }
+        int start = cursor.position();
+        if (isMuc_) {
+            renderMucMessage(mv, cursor);
+        } else {
+            renderMessage(mv, cursor);
+        }
+        QTextCursor startCursor(document());
+        startCursor.setPosition(start);
+        PsiRichText::insertMarker(startCursor, mv.messageId() + "_" + mv.userId());
+        newMarkers.append({ mv.messageId() + "_" + mv.userId(), start });
+        PsiRichText::insertMarker(cursor, QString()); // end marker
+        messages_.insert(i, { mv.messageId() + "_" + mv.userId(), mv.dateTime() });
+    }
+    cursor.endEditBlock();
+
+    markersShift_ += document()->characterCount() - oldLength;
+    for (const auto &marker : newMarkers) {
+        markers_.insert(marker.first, marker.second - markersShift_);
+    }
+
+    if (oldTrackBarPosition) {
+        oldTrackBarPosition += document()->characterCount() - oldLength;
+    }
+    sb->setValue(sb->maximum() - fromBottom);
+}
+
+/**
+ * Drops the oldest messages when there are more of them in the document
+ * than options.ui.chat.max-scrollback allows. Only the views which can load them back
+ * from the history are trimmed (see setHistoryAvailable()), group chats are kept whole.
+ */
+void ChatView::trimScrollback()
+{
+    int limit = PsiOptions::instance()->getOption("options.ui.chat.max-scrollback").toInt();
+    if (limit <= 0 || !isHistoryAvailable() || messages_.size() <= limit) {
+        return;
+    }
+
+    int         oldLength = document()->characterCount();
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    while (messages_.size() > limit) {
+        cursor.setPosition(0);
+        // everything up to the first end marker belongs to the oldest message
+        QTextCursor fin = PsiRichText::findMarker(cursor, QString());
+        if (fin.isNull()) {
+            break;
+        }
+        cursor.setPosition(fin.selectionEnd(), QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+        markers_.remove(messages_.takeFirst().markerId);
+        ++trimmedMessages_;
+    }
+    // the start marker of the next message is left alone on the first line. join them
+    QTextBlock first = document()->firstBlock();
+    if (first.next().isValid() && first.text().count(QChar::ObjectReplacementCharacter) == first.text().length()) {
+        cursor.setPosition(first.position() + first.length() - 1);
+        cursor.deleteChar();
+    }
+    cursor.endEditBlock();
+
+    markersShift_ -= oldLength - document()->characterCount();
+    if (oldTrackBarPosition) {
+        oldTrackBarPosition = qMax(0, oldTrackBarPosition - (oldLength - document()->characterCount()));
+    }
+}
+
+void ChatView::checkScrollback(int value)
+{
+    if (value == verticalScrollBar()->minimum() && trimmedMessages_ > 0 && !olderRequested_
+        && !messages_.isEmpty()) {
+        olderRequested_ = true;
+
+        // the history keeps seconds only, so the messages shown from the same second
+        // as the oldest one can't be told from the older ones by the time alone
+        const QDateTime oldest = messages_.first().time;
+        const qint64    second = oldest.toMSecsSinceEpoch() / 1000;
+        int             shown  = 0;
+        while (shown < messages_.size() && messages_.at(shown).time.toMSecsSinceEpoch() / 1000 == second)
+            ++shown;
+        emit olderMessagesRequested(oldest, qMin(trimmedMessages_, historyPageSize), shown);
+    }
+}
+
+QString ChatView::dateSeparator(const QDate &date) const
+{
+    QString color = ColorOpt::instance()->color(informationalColorOpt).name();
+    return QString(useMessageIcons_ ? "<img src=\"icon:log_icon_time\" />" : "")
+        + QString("<font color=\"%1\">*** %2</font>").arg(color, date.toString(Qt::ISODate));
+}
+
 QString ChatView::replaceMarker(const MessageView &mv) const
 {
     return "<a name=\"msgid_" + TextUtil::escape(mv.messageId() + "_" + mv.userId()) + "\"> </a>";
 }
 
+/**
+ * Inserts start marker of the message with \a id and indexes its place.
+ * Only the position is kept, live cursors would be adjusted by the document on every insert.
+ */
+void ChatView::insertMessageMarker(QTextCursor &cursor, const QString &id)
+{
+    PsiRichText::insertMarker(cursor, id);
+    markers_.insert(id, cursor.position() - 1 - markersShift_);
+}
+
+/**
+ * Returns selection of start marker of the message with \a id or null cursor if it's not in the document.
+ * The text added or removed at the top is accounted by markersShift_. If a corrected message has moved
+ * the marker, it's looked up in the document and its position is fixed.
+ */
+QTextCursor ChatView::findMessageMarker(const QString &id)
+{
+    auto it = markers_.find(id);
+    if (it == markers_.end()) {
+        return QTextCursor();
+    }
+
+    const int   pos = it.value() + markersShift_;
+    QTextCursor marker(document());
+    if (pos >= 0 && pos + 1 < document()->characterCount()) {
+        marker.setPosition(pos);
+        marker.setPosition(pos + 1, QTextCursor::KeepAnchor);
+        if (PsiRichText::isMarker(marker, id)) {
+            return marker;
+        }
+    }
+
+    marker = PsiRichText::findMarker(QTextCursor(document()), id);
+    if (marker.isNull()) { // removed together with the text around
+        markers_.erase(it);
+        return QTextCursor();
+    }
+    it.value() = marker.selectionStart() - markersShift_;
+    return marker;
+}
+
 void ChatView::renderMucMessage(const MessageView &mv, QTextCursor &insertCursor)
 {
     const QString timestr = formatTimeStamp(mv.dateTime());
@@ -426,8 +702,13 @@ void ChatView::renderMucMessage(const MessageView &mv, QTextCursor &insertCursor
         }
     }
 
-    if (mv.isLocal() && PsiOptions::instance()->getOption("options.ui.chat.auto-scroll-to-bottom").toBool()) {
-        scrollToBottom();
+    if (mv.isLocal() && !mv.isSpooled()
+        && PsiOptions::instance()->getOption("options.ui.chat.auto-scroll-to-bottom").toBool()) {
+        if (batchCursor_.isNull()) {
+            scrollToBottom();
+        } else {
+            batchAtBottom_ = true;
+        }
     }
 }
 
@@ -484,8 +765,13 @@ void ChatView::renderMessage(const MessageView &mv, QTextCursor &insertCursor)
     }
     insertText(str, insertCursor);
 
-    if (mv.isLocal() && PsiOptions::instance()->getOption("options.ui.chat.auto-scroll-to-bottom").toBool()) {
-        deferredScroll();
+    if (mv.isLocal() && !mv.isSpooled()
+        && PsiOptions::instance()->getOption("options.ui.chat.auto-scroll-to-bottom").toBool()) {
+        if (batchCursor_.isNull()) {
+            deferredScroll();
+        } else {
+            batchAtBottom_ = true; // endBatch() scrolls once for the whole batch
+        }
     }
 }
 
@@ -576,6 +862,7 @@ void ChatView::updateAvatar(const XMPP::Jid &jid, ChatViewCommon::UserType utype
 
 void ChatView::doTrackBar()
 {
+    endBatch();
     // save position, because our manipulations could change it
     int scrollbarValue = verticalScrollBar()->value();
 
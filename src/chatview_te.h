@@ -26,6 +26,7 @@
 
 #include <QContextMenuEvent>
 #include <QDateTime>
+#include <QHash>
 #include <QPointer>
 #include <QWidget>
 
@@ -61,6 +62,8 @@ public:
     void insertText(const QString &text, QTextCursor &insertCursor);
     void appendText(const QString &text);
     void dispatchMessage(const MessageView &);
+    void prependMessages(const QList<MessageView> &messages);
+    void restoreSpilledMessages(const QList<MessageView> &messages);
     bool handleCopyEvent(QObject *object, QEvent *event, ChatEdit *chatEdit);
 
     void      deferredScroll();
@@ -79,39 +82,64 @@ protected:
     // override the tab/esc behavior
     bool focusNextPrevChild(bool next);
     void keyPressEvent(QKeyEvent *);
+    void showEvent(QShowEvent *);
+
+    void flushHeldMessages();
 
     QString formatTimeStamp(const QDateTime &time);
+    QString dateSeparator(const QDate &date) const;
     QString colorString(bool local, bool spooled) const;
 
-    QString replaceMarker(const MessageView &mv) const;
-    void    renderMucMessage(const MessageView &, QTextCursor &insertCursor);
-    void    renderMessage(const MessageView &, QTextCursor &insertCursor);
-    void    renderSysMessage(const MessageView &);
-    void    renderSubject(const MessageView &);
-    void    renderMucSubject(const MessageView &);
-    void    renderUrls(const MessageView &);
+    QString     replaceMarker(const MessageView &mv) const;
+    void        insertMessageMarker(QTextCursor &cursor, const QString &id);
+    QTextCursor findMessageMarker(const QString &id);
+    void        renderMucMessage(const MessageView &, QTextCursor &insertCursor);
+    void        renderMessage(const MessageView &, QTextCursor &insertCursor);
+    void        renderSysMessage(const MessageView &);
+    void        renderSubject(const MessageView &);
+    void        renderMucSubject(const MessageView &);
+    void        renderUrls(const MessageView &);
+    void        trimScrollback();
+    void        beginBatch();
 
 protected slots:
     void autoCopy();
 
 private slots:
+    void endBatch();
     void slotScroll();
+    void checkScrollback(int value);
 
 signals:
     void showNM(const QString &);
     void quote(const QString &text);
     void nickInsertClick(const QString &nick);
+    void olderMessagesRequested(const QDateTime &oldest, int count, int shownAtOldest);
+    void spilledMessagesRequested(const QDateTime &newest, int count, int heldAtNewest);
 
 private:
-    bool              isMuc_;
-    bool              isMucPrivate_;
-    bool              isEncryptionEnabled_;
-    bool              useMessageIcons_;
-    int               oldTrackBarPosition;
-    XMPP::Jid         jid_;
-    QString           name_;
-    QPointer<QWidget> dialog_;
-    QAction *         actQuote_;
+    struct MessageEntry {
+        QString   markerId;
+        QDateTime time;
+    };
+
+    bool                isMuc_;
+    bool                isMucPrivate_;
+    bool                isEncryptionEnabled_;
+    bool                useMessageIcons_;
+    int                 oldTrackBarPosition;
+    int                 trimmedMessages_ = 0;     // messages dropped from the top of the document
+    bool                olderRequested_  = false; // waiting for prependMessages()
+    QTextCursor         batchCursor_;             // holds the edit block of the current batch. see beginBatch()
+    bool                batchAtBottom_  = false;
+    int                 batchScrollPos_ = 0;
+    QList<MessageEntry> messages_;         // messages in the document, oldest first
+    QHash<QString, int> markers_;          // start marker positions of the messages, less markersShift_
+    int                 markersShift_ = 0; // follows the text added and removed at the top
+    XMPP::Jid           jid_;
+    QString             name_;
+    QPointer<QWidget>   dialog_;
+    QAction *           actQuote_;
 };
 
 #endif // CHATVIEW_TE_H
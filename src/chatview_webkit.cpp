@@ -44,6 +44,7 @@
 #include <QAction>
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QJsonDocument>
@@ -53,6 +54,7 @@
 #include <QMetaProperty>
 #include <QNetworkReply>
 #include <QPalette>
+#include <QTimer>
 #include <QWidget>
 #ifdef WEBENGINE
 #if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
@@ -68,6 +70,14 @@
 class ChatViewJSObject;
 class ChatViewThemeSessionBridge;
 
+// Messages are sent to the page in batches. The next batch is sent only when the page
+// reports the previous one is processed. Batch size grows while the page keeps up
+// and shrinks when it lags behind.
+static const int minJsBatchSize   = 4;
+static const int maxJsBatchSize   = 256;
+static const int fastJsBatchMsecs = 40;  // about two animation frames
+static const int slowJsBatchMsecs = 150; // visible input lag
+
 class ChatViewPrivate {
 public:
     ChatViewPrivate() = default;
@@ -77,7 +87,11 @@ public:
     WebView *                 webView  = nullptr;
     ChatViewJSObject *        jsObject = nullptr;
     QList<QVariantMap>        jsBuffer_;
-    bool                      sessionReady_ = false;
+    bool                      sessionReady_   = false;
+    bool                      jsFlushQueued_  = false;
+    bool                      jsBatchPending_ = false; // sent to the page but not acknowledged yet
+    int                       jsBatchSize_    = minJsBatchSize;
+    QElapsedTimer             jsBatchTimer_;
     QPointer<QWidget>         dialog_;
     bool                      isMuc_               = false;
     bool                      isMucPrivate_        = false;
@@ -275,6 +289,9 @@ public slots:
 
     void nickInsertClick(const QString &nick) { emit _view->nickInsertClick(nick); }
 
+    // called by the page when it has rendered a batch received with newMessages()
+    void messagesProcessed() { _view->jsBatchProcessed(); }
+
     void getUrlHeaders(const QString &tId, const QString url)
     {
         QNetworkRequest req(QUrl::fromEncoded(url.toLatin1()));
@@ -322,6 +339,14 @@ signals:
     void localUserImageChanged(const QString &);
     void localUserAvatarChanged(const QString &);
     void newMessage(const QVariant &);
+    void newMessages(const QVariantList &);
+
+public:
+    // old themes don't know about batches and listen only to newMessage
+    bool isBatchingSupported() const
+    {
+        return isSignalConnected(QMetaMethod::fromSignal(&ChatViewJSObject::newMessages));
+    }
 };
 
 //----------------------------------------------------------------------------
@@ -397,18 +422,84 @@ signals:
     void quote(const QString &text);
 };
 
+//----------------------------------------------------------------------------
+// ChatWebViewPool
+// Keeps a few web views with their pages already created so a new chat
+// doesn't wait for page (and with webengine the render process) creation.
+//----------------------------------------------------------------------------
+class ChatWebViewPool : public QObject {
+    Q_OBJECT
+
+public:
+    static ChatWebViewPool *instance()
+    {
+        if (!instance_) {
+            instance_ = new ChatWebViewPool();
+        }
+        return instance_;
+    }
+
+    static void reset()
+    {
+        delete instance_;
+        instance_ = nullptr;
+    }
+
+    ChatWebView *take(QWidget *parent)
+    {
+        ChatWebView *view = views_.isEmpty() ? createView() : views_.takeFirst();
+        view->setParent(parent);
+        refillTimer_.start();
+        return view;
+    }
+
+    void warmUp() { refillTimer_.start(); }
+
+private:
+    ChatWebViewPool()
+    {
+        // refill in idle time: a zero timer fires once the pending events are processed.
+        // one view per shot, so the events coming meanwhile are not held up by the whole pool
+        refillTimer_.setSingleShot(true);
+        refillTimer_.setInterval(0);
+        connect(&refillTimer_, &QTimer::timeout, this, [this]() {
+            if (views_.size() < poolSize) {
+                views_.append(createView());
+                refillTimer_.start();
+            }
+        });
+    }
+
+    ~ChatWebViewPool() { qDeleteAll(views_); }
+
+    static ChatWebView *createView()
+    {
+        auto view = new ChatWebView(nullptr);
+        view->setFocusPolicy(Qt::NoFocus);
+        view->setPage(new ChatViewPage(view));
+#ifdef WEBENGINE
+        view->page()->setHtml(QString()); // starts render process
+#else
+        view->settings()->setAttribute(QWebSettings::DeveloperExtrasEnabled, true);
+#endif
+        return view;
+    }
+
+    static const int         poolSize = 2;
+    static ChatWebViewPool * instance_;
+    QList<ChatWebView *>     views_;
+    QTimer                   refillTimer_;
+};
+
+ChatWebViewPool *ChatWebViewPool::instance_ = nullptr;
+
 //----------------------------------------------------------------------------
 // ChatView
 //----------------------------------------------------------------------------
 ChatView::ChatView(QWidget *parent) : QFrame(parent), d(new ChatViewPrivate)
 {
     d->jsObject = new ChatViewJSObject(this); /* It's a session bridge between html and c++ part */
-    d->webView  = new ChatWebView(this);
-    d->webView->setFocusPolicy(Qt::NoFocus);
-    d->webView->setPage(new ChatViewPage(d->webView));
-#ifndef WEBENGINE
-    d->webView->settings()->setAttribute(QWebSettings::DeveloperExtrasEnabled, true);
-#endif
+    d->webView  = ChatWebViewPool::instance()->take(this);
     QVBoxLayout *layout = new QVBoxLayout;
     layout->setContentsMargins(0, 0, 0, 0);
     layout->addWidget(d->webView);
@@ -449,6 +540,16 @@ ChatView::~ChatView()
 #endif
 }
 
+/**
+ * Starts preparing web views for chats to be opened
+ */
+void ChatView::warmUpWebViews() { ChatWebViewPool::instance()->warmUp(); }
+
+/**
+ * Releases prepared web views. Has to be called before web engine shutdown.
+ */
+void ChatView::releaseWebViews() { ChatWebViewPool::reset(); }
+
 // something after we know isMuc and dialog is set. kind of final step
 void ChatView::init()
 {
@@ -478,6 +579,9 @@ void ChatView::setEncryptionEnabled(bool enabled) { d->isEncryptionEnabled_ = en
 
 void ChatView::markReceived(QString id)
 {
+    if (markHeldMessageReceived(id)) {
+        return;
+    }
     QVariantMap m;
     m["type"]      = "receipt";
     m["id"]        = id;
@@ -542,6 +646,46 @@ void ChatView::changeEvent(QEvent *event)
     QFrame::changeEvent(event);
 }
 
+void ChatView::showEvent(QShowEvent *event)
+{
+    QFrame::showEvent(event);
+    flushHeldMessages();
+}
+
+/**
+ * Sends to the page messages received while the view was hidden. If some of them were left to the history,
+ * they are requested first and everything goes out in restoreSpilledMessages()
+ */
+void ChatView::flushHeldMessages()
+{
+    if (isRestoringSpilled()) {
+        return;
+    }
+
+    QDateTime newest;
+    int       count, heldAtNewest;
+    if (takeSpilledRange(&newest, &count, &heldAtNewest)) {
+        emit spilledMessagesRequested(newest, count, heldAtNewest);
+        return;
+    }
+
+    const auto held = takeHeldMessages();
+    for (const MessageView &mv : held) {
+        dispatchMessage(mv);
+    }
+}
+
+/**
+ * Called in reply to spilledMessagesRequested() with the \a messages loaded back from the history, oldest first
+ */
+void ChatView::restoreSpilledMessages(const QList<MessageView> &messages)
+{
+    const auto held = takeHeldMessages(messages);
+    for (const MessageView &mv : held) {
+        dispatchMessage(mv);
+    }
+}
+
 void ChatView::psiOptionChanged(const QString &option)
 {
     if (option == "options.ui.automatically-copy-selected-text") {
@@ -556,22 +700,63 @@ void ChatView::psiOptionChanged(const QString &option)
 void ChatView::sendJsObject(const QVariantMap &map)
 {
     d->jsBuffer_.append(map);
-    checkJsBuffer();
+    if (!d->jsFlushQueued_) {
+        // collect everything appended during this event loop iteration into one batch
+        d->jsFlushQueued_ = true;
+        QTimer::singleShot(0, this, SLOT(checkJsBuffer()));
+    }
 }
 
 void ChatView::checkJsBuffer()
 {
-    if (d->sessionReady_) {
+    d->jsFlushQueued_ = false;
+    if (!d->sessionReady_ || d->jsBuffer_.isEmpty()) {
+        return;
+    }
+
+    if (!d->jsObject->isBatchingSupported()) {
         while (!d->jsBuffer_.isEmpty()) {
             d->jsObject->newMessage(d->jsBuffer_.takeFirst());
         }
+        return;
     }
+
+    if (d->jsBatchPending_) {
+        return; // the page is still busy with the previous batch
+    }
+
+    int          count = qMin(d->jsBatchSize_, d->jsBuffer_.size());
+    QVariantList batch;
+    batch.reserve(count);
+    for (int i = 0; i < count; i++) {
+        batch.append(d->jsBuffer_.takeFirst());
+    }
+    d->jsBatchPending_ = true;
+    d->jsBatchTimer_.start();
+    emit d->jsObject->newMessages(batch);
+}
+
+void ChatView::jsBatchProcessed()
+{
+    if (!d->jsBatchPending_) {
+        return;
+    }
+    d->jsBatchPending_ = false;
+
+    qint64 elapsed = d->jsBatchTimer_.elapsed();
+    if (elapsed < fastJsBatchMsecs) {
+        d->jsBatchSize_ = qMin(d->jsBatchSize_ * 2, maxJsBatchSize);
+    } else if (elapsed > slowJsBatchMsecs) {
+        d->jsBatchSize_ = qMax(d->jsBatchSize_ / 2, minJsBatchSize);
+    }
+    checkJsBuffer();
 }
 
 void ChatView::sessionInited()
 {
     qDebug("Session is initialized");
-    d->sessionReady_ = true;
+    d->sessionReady_   = true;
+    d->jsBatchPending_ = false; // a batch sent to the previous page won't be acknowledged
     checkJsBuffer();
 }
 
@@ -592,6 +777,10 @@ bool ChatView::handleCopyEvent(QObject *object, QEvent *event, ChatEdit *chatEdi
 // input point of all messages
 void ChatView::dispatchMessage(const MessageView &mv)
 {
+    if (holdHiddenMessage(this, mv)) {
+        return;
+    }
+
     QString replaceId = mv.replaceId();
     if (replaceId.isEmpty() && (mv.type() == MessageView::Message || mv.type() == MessageView::Subject)
         && updateLastMsgTime(mv.dateTime())) {
@@ -678,6 +867,7 @@ void ChatView::updateAvatar(const Jid &jid, ChatViewCommon::UserType utype)
 
 void ChatView::clear()
 {
+    clearHeldMessages();
     QVariantMap m;
     m["type"] = "clear";
     sendJsObject(m);
@@ -45,6 +45,9 @@ public:
     ChatView(QWidget *parent);
     ~ChatView();
 
+    static void warmUpWebViews();
+    static void releaseWebViews();
+
     void markReceived(QString id);
 
     // reimplemented
@@ -59,6 +62,7 @@ public:
 
     void sendJsObject(const QVariantMap &);
     void dispatchMessage(const MessageView &m);
+    void restoreSpilledMessages(const QList<MessageView> &messages);
     void sendJsCode(const QString &js);
 
     void     clear();
@@ -78,6 +82,9 @@ protected:
     // override the tab/esc behavior
     bool focusNextPrevChild(bool next);
     void changeEvent(QEvent *event);
+    void showEvent(QShowEvent *event);
+
+    void flushHeldMessages();
     // void keyPressEvent(QKeyEvent *);
 
 protected slots:
@@ -91,9 +98,13 @@ private slots:
     void checkJsBuffer();
     void sessionInited();
 
+private:
+    void jsBatchProcessed();
+
 signals:
     void showNM(const QString &);
     void nickInsertClick(const QString &nick);
+    void spilledMessagesRequested(const QDateTime &newest, int count, int heldAtNewest);
 
 private:
     friend class ChatViewPrivate;
@@ -80,6 +80,121 @@ QString ChatViewCommon::getMucNickColor(const QString &nick, bool isSelf)
     return QLatin1String("#000000"); // FIXME it's bad for fallback color
 }
 
+// messages which can be loaded back from the history
+static bool isLoggedMessage(const MessageView &mv)
+{
+    return mv.type() == MessageView::Message && mv.replaceId().isEmpty();
+}
+
+/**
+ * Stores \a mv for later rendering if \a view is not on screen (hidden tab, minimized window
+ * or not shown yet). Returns false if the message has to be rendered right away.
+ * If the chat is logged (see setHistoryAvailable()) at most "options.ui.chat.hidden-buffer-size"
+ * messages are kept, the oldest chat messages above that are left to the history and only their
+ * count and time are remembered. Group chats are not logged locally, so their messages are all kept.
+ */
+bool ChatViewCommon::holdHiddenMessage(const QWidget *view, const MessageView &mv)
+{
+    if (!_restoringSpilled && view->isVisible() && !view->window()->isMinimized()) {
+        return false;
+    }
+
+    int limit = PsiOptions::instance()->getOption("options.ui.chat.hidden-buffer-size").toInt();
+    if (limit <= 0 && !_restoringSpilled) {
+        return false;
+    }
+
+    _heldMessages.append(mv);
+    if (!_historyAvailable || _restoringSpilled) {
+        return true;
+    }
+
+    for (auto it = _heldMessages.begin(); _heldMessages.size() > limit && it != _heldMessages.end();) {
+        if (isLoggedMessage(*it)) {
+            _spilledNewest = it->dateTime();
+            _spilledCount++;
+            it = _heldMessages.erase(it);
+        } else {
+            ++it; // status lines and the like are not in the history
+        }
+    }
+    return true;
+}
+
+/**
+ * Clears the delivery receipt flag of a held message. Returns true if the message was found.
+ */
+bool ChatViewCommon::markHeldMessageReceived(const QString &id)
+{
+    for (auto it = _heldMessages.rbegin(); it != _heldMessages.rend(); ++it) {
+        if (it->messageId() == id) {
+            it->setAwaitingReceipt(false);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns false if no messages were left to the history. Otherwise fills in what has to be loaded back:
+ * the \a count history messages up to the second of the \a newest one, not counting the
+ * \a heldAtNewest held messages of that second which follow them. The held messages stay in the buffer,
+ * and so do the ones arriving meanwhile, till takeHeldMessages() is called with the loaded messages.
+ */
+bool ChatViewCommon::takeSpilledRange(QDateTime *newest, int *count, int *heldAtNewest)
+{
+    if (!_spilledCount || _restoringSpilled) {
+        return false;
+    }
+
+    const qint64 second = _spilledNewest.toMSecsSinceEpoch() / 1000;
+    *newest             = _spilledNewest;
+    *count              = _spilledCount;
+    *heldAtNewest       = 0;
+    for (const MessageView &mv : _heldMessages) {
+        if (isLoggedMessage(mv) && mv.dateTime().toMSecsSinceEpoch() / 1000 == second) {
+            ++*heldAtNewest;
+        }
+    }
+    _restoringSpilled = true;
+    return true;
+}
+
+/**
+ * Returns all the held messages in arrival order and empties the buffer.
+ * If the view waits for the spilled messages (see takeSpilledRange()), the \a restored ones
+ * are merged in by time. Otherwise \a restored is ignored, e.g. when the view was cleared meanwhile.
+ */
+QList<MessageView> ChatViewCommon::takeHeldMessages(const QList<MessageView> &restored)
+{
+    QList<MessageView> ret;
+    if (_restoringSpilled) {
+        const auto &held = _heldMessages;
+        auto        it   = restored.cbegin();
+        for (const MessageView &mv : held) {
+            for (; it != restored.cend() && it->dateTime() <= mv.dateTime(); ++it) {
+                ret.append(*it);
+            }
+            ret.append(mv);
+        }
+        for (; it != restored.cend(); ++it) {
+            ret.append(*it);
+        }
+    } else {
+        ret = _heldMessages;
+    }
+    clearHeldMessages();
+    return ret;
+}
+
+void ChatViewCommon::clearHeldMessages()
+{
+    _heldMessages.clear();
+    _spilledNewest    = QDateTime();
+    _spilledCount     = 0;
+    _restoringSpilled = false;
+}
+
 QList<QColor> &ChatViewCommon::generatePalette()
 {
     static QColor        bg;
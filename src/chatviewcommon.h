@@ -20,8 +20,11 @@
 #ifndef CHATVIEWBASE_H
 #define CHATVIEWBASE_H
 
+#include "messageview.h"
+
 #include <QColor>
 #include <QDateTime>
+#include <QList>
 #include <QMap>
 #include <QStringList>
 
@@ -37,8 +40,17 @@ public:
     bool                    updateLastMsgTime(QDateTime t);
     QString                 getMucNickColor(const QString &, bool);
     QList<QColor>           getPalette();
+    inline void             setHistoryAvailable(bool available) { _historyAvailable = available; }
+    inline bool             isHistoryAvailable() const { return _historyAvailable; }
 
 protected:
+    bool               holdHiddenMessage(const QWidget *view, const MessageView &mv);
+    bool               markHeldMessageReceived(const QString &id);
+    bool               takeSpilledRange(QDateTime *newest, int *count, int *heldAtNewest);
+    QList<MessageView> takeHeldMessages(const QList<MessageView> &restored = QList<MessageView>());
+    void               clearHeldMessages();
+    inline bool        isRestoringSpilled() const { return _restoringSpilled; }
+
     QDateTime _lastMsgTime;
 
 private:
@@ -46,6 +58,12 @@ private:
     bool               compatibleColors(const QColor &, const QColor &);
     int                _nickNumber;
     QMap<QString, int> _nicks;
+
+    QList<MessageView> _heldMessages;             // arrived while the view was hidden
+    QDateTime          _spilledNewest;            // the newest message left to the history
+    int                _spilledCount     = 0;     // messages left to the history on buffer overflow
+    bool               _historyAvailable = false; // the messages of this chat are logged
+    bool               _restoringSpilled = false; // waiting for takeHeldMessages() with the spilled messages
 };
 
 #endif // CHATVIEWBASE_H
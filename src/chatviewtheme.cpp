@@ -32,6 +32,8 @@
 #include "webview.h"
 
 #include <QApplication>
+#include <QBuffer>
+#include <QCryptographicHash>
 #include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -53,6 +55,8 @@
 #include <QWebPage>
 #endif
 
+static const int resourceCacheSize = 4 * 1024 * 1024; // bytes of theme files kept in memory per theme
+
 #ifndef WEBENGINE
 QVariant ChatViewThemePrivate::evaluateFromFile(const QString fileName, QWebFrame *frame)
 {
@@ -67,6 +71,7 @@ QVariant ChatViewThemePrivate::evaluateFromFile(const QString fileName, QWebFram
 ChatViewThemePrivate::ChatViewThemePrivate(ChatViewThemeProvider *provider) : ThemePrivate(provider)
 {
     nam = provider->psi()->networkAccessManager();
+    resources.setMaxCost(resourceCacheSize);
 }
 
 ChatViewThemePrivate::~ChatViewThemePrivate() { delete wv; }
@@ -227,6 +232,47 @@ void ChatViewThemePrivate::embedSessionJsObject(ChatViewThemeSession *session)
 }
 #endif
 
+/**
+ * Loads theme file at \a path (relative to theme's http root) the way it's served to sessions.
+ * Every chat window requests the same files, so they are read from the theme and converted only once.
+ */
+bool ChatViewThemePrivate::loadResource(const QString &path, Resource &resource)
+{
+    Resource *cached = resources.object(path);
+    if (cached) {
+        resource = *cached;
+        return true;
+    }
+
+    bool       loaded;
+    QByteArray data = loadData(httpRelPath + path, &loaded);
+    if (!loaded) {
+        return false;
+    }
+
+    resource = Resource();
+    if (!data.isNull() && path.endsWith(QLatin1String(".tiff"))) {
+        // seems like we are loading tiff image which is supported by safari only.
+        // let's convert it
+        QImage     image(QImage::fromData(data));
+        QByteArray ba;
+        QBuffer    buffer(&ba);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+        if (!ba.isNull()) {
+            data                 = ba;
+            resource.contentType = "image/png";
+        }
+    } else if (path.endsWith(QLatin1String(".css"))) {
+        resource.contentType = "text/css;charset=utf-8";
+    }
+    resource.data = data;
+    resource.etag = '"' + QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex() + '"';
+
+    resources.insert(path, new Resource(resource), qMax(1, data.size()));
+    return true;
+}
+
 bool ChatViewThemePrivate::applyToSession(ChatViewThemeSession *session)
 {
 #ifdef WEBENGINE
@@ -305,26 +351,22 @@ bool ChatViewThemePrivate::applyToSession(ChatViewThemeSession *session)
             }
             return true;
         } else {
-            bool       loaded;
-            QByteArray data = loadData(httpRelPath + path, &loaded);
-            if (loaded) {
-                if (!data.isNull() && path.endsWith(QLatin1String(".tiff"))) {
-                    // seems like we are loading tiff image which is supported by safari only.
-                    // let's convert it
-                    QImage     image(QImage::fromData(data));
-                    QByteArray ba;
-                    QBuffer    buffer(&ba);
-                    buffer.open(QIODevice::WriteOnly);
-                    image.save(&buffer, "PNG");
-                    if (!ba.isNull()) {
-                        data = ba;
-                    }
+            Resource resource;
+            if (loadResource(path, resource)) {
+                // All the themes are served from the same urls, so the browser
+                // has to revalidate its copy with the theme's etag each time.
+                res->headers().insert("Cache-Control", "no-cache");
+                res->headers().insert("ETag", resource.etag);
+                if (req->headers().value("if-none-match") == resource.etag) {
+                    res->setStatusCode(qhttp::ESTATUS_NOT_MODIFIED);
+                    res->end();
+                    return true;
                 }
-                if (path.endsWith(QLatin1String(".css"))) {
-                    res->headers().insert("Content-Type", "text/css;charset=utf-8");
+                if (!resource.contentType.isEmpty()) {
+                    res->headers().insert("Content-Type", resource.contentType);
                 }
                 res->setStatusCode(qhttp::ESTATUS_OK);
-                res->end(data);
+                res->end(resource.data);
                 return true;
             }
         }
@@ -355,12 +397,16 @@ bool ChatViewThemePrivate::applyToSession(ChatViewThemeSession *session)
 
     session->sessId = nam->registerSessionHandler(
         [session](const QNetworkRequest &req, QByteArray &data, QByteArray &mime) {
-            Q_UNUSED(mime)
-            data = session->theme.loadData(session->theme.priv<ChatViewThemePrivate>()->httpRelPath + req.url().path());
-            if (!data.isNull()) {
-                return true;
+            ChatViewThemePrivate::Resource resource;
+            if (!session->theme.priv<ChatViewThemePrivate>()->loadResource(req.url().path(), resource)
+                || resource.data.isNull()) {
+                return false;
             }
-            return false;
+            data = resource.data;
+            if (!resource.contentType.isEmpty()) {
+                mime = resource.contentType;
+            }
+            return true;
         });
 
     QString html;
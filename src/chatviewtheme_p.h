@@ -23,6 +23,7 @@
 #include "chatviewtheme.h"
 #include "theme_p.h"
 
+#include <QCache>
 #include <QPointer>
 #include <QScopedPointer>
 #include <QTimer>
@@ -133,6 +134,13 @@ private slots:
 
 class ChatViewThemePrivate : public ThemePrivate {
 public:
+    // theme file prepared for sending to a session
+    struct Resource {
+        QByteArray data;
+        QByteArray contentType; // empty if the browser should guess
+        QByteArray etag;
+    };
+
     QString                             html;
     QString                             httpRelPath;
     QScopedPointer<ChatViewJSLoader>    jsLoader;
@@ -142,6 +150,7 @@ public:
     bool                           prepareSessionHtml    = false; // if html should be generated by JS for each session.
     bool                           transparentBackground = false;
     QPointer<NetworkAccessManager> nam;
+    QCache<QString, Resource>      resources; // served theme files. the cost is size in bytes
 
 #ifdef WEBENGINE
     QList<QWebEngineScript> scripts;
@@ -171,6 +180,7 @@ public:
     void embedSessionJsObject(ChatViewThemeSession *session);
 #endif
     bool applyToSession(ChatViewThemeSession *session);
+    bool loadResource(const QString &path, Resource &resource);
 
     QVariantMap loadFromCacheMulti(const QVariantList &list);
 };
@@ -0,0 +1,80 @@
+/*
+ * completionindex.cpp - sorted word index for tab completion
+ * Copyright (C) 2020  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "completionindex.h"
+
+#include <algorithm>
+
+void CompletionIndex::insert(const QString &word)
+{
+    Entry e { word.toLower(), word };
+    auto  it = std::lower_bound(entries_.begin(), entries_.end(), e);
+    if (it != entries_.end() && it->word == word) {
+        return; // already indexed
+    }
+    entries_.insert(it, e);
+}
+
+void CompletionIndex::remove(const QString &word)
+{
+    Entry e { word.toLower(), word };
+    auto  it = std::lower_bound(entries_.begin(), entries_.end(), e);
+    if (it != entries_.end() && it->word == word) {
+        entries_.erase(it);
+    }
+}
+
+void CompletionIndex::clear() { entries_.clear(); }
+
+bool CompletionIndex::contains(const QString &word) const
+{
+    Entry e { word.toLower(), word };
+    auto  it = std::lower_bound(entries_.cbegin(), entries_.cend(), e);
+    return it != entries_.cend() && it->word == word;
+}
+
+QStringList CompletionIndex::words() const
+{
+    QStringList ret;
+    ret.reserve(entries_.size());
+    for (const Entry &e : entries_) {
+        ret << e.word;
+    }
+    return ret;
+}
+
+/** Returns all the indexed words starting with \a prefix (case insensitive),
+ * in index order. Costs O(log n) to locate the range plus the size of the result.
+ */
+QStringList CompletionIndex::startingWith(const QString &prefix) const
+{
+    if (prefix.isEmpty()) {
+        return words();
+    }
+
+    const QString lowerPrefix = prefix.toLower();
+    auto          it          = std::lower_bound(entries_.cbegin(), entries_.cend(), lowerPrefix,
+                                   [](const Entry &e, const QString &key) { return e.key.compare(key) < 0; });
+
+    QStringList ret;
+    for (; it != entries_.cend() && it->key.startsWith(lowerPrefix); ++it) {
+        ret << it->word;
+    }
+    return ret;
+}
@@ -0,0 +1,60 @@
+/*
+ * completionindex.h - sorted word index for tab completion
+ * Copyright (C) 2020  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COMPLETIONINDEX_H
+#define COMPLETIONINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/** Case insensitive sorted set of words with prefix lookup.
+ * Words are kept ordered by their lowercased form, so all the words starting
+ * with a given prefix form one contiguous range which is found by binary search.
+ * The index is meant to be updated incrementally (e.g. on MUC occupant join/leave)
+ * instead of being rebuilt on each completion request.
+ */
+class CompletionIndex {
+public:
+    void insert(const QString &word);
+    void remove(const QString &word);
+    void clear();
+
+    bool contains(const QString &word) const;
+    int  count() const { return entries_.size(); }
+
+    QStringList words() const;
+    QStringList startingWith(const QString &prefix) const;
+
+private:
+    struct Entry {
+        QString key; // lowercased word
+        QString word;
+
+        bool operator<(const Entry &other) const
+        {
+            int c = key.compare(other.key);
+            return c < 0 || (c == 0 && word < other.word);
+        }
+    };
+
+    QVector<Entry> entries_;
+};
+
+#endif // COMPLETIONINDEX_H
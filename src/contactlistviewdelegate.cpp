@@ -107,6 +107,9 @@ static QRect relativeRect(const QStyleOption &option, const QSize &size, const Q
     return r;
 }
 
+// pixmap width in device independent pixels. the icons are rendered for the screen's pixel ratio
+static int logicalWidth(const QPixmap &pix) { return qRound(pix.width() / pix.devicePixelRatio()); }
+
 /************************************/
 /* ContactListViewDelegate::Private */
 /************************************/
@@ -506,8 +509,10 @@ QPixmap ContactListViewDelegate::Private::rosterIndicator(const QString iconName
     auto    iconHeight  = pepIconsRect_.height();
     auto    desiredSize = QSize(iconHeight, iconHeight);
     QPixmap pix         = IconsetFactory::iconPixmap(iconName, desiredSize);
-    if (pix.height() > iconHeight * HugeIconRosterK) {
-        pix = pix.scaledToHeight(iconHeight, Qt::SmoothTransformation);
+    qreal   dpr         = pix.devicePixelRatio();
+    if (pix.height() > iconHeight * HugeIconRosterK * dpr) {
+        pix = pix.scaledToHeight(qRound(iconHeight * dpr), Qt::SmoothTransformation);
+        pix.setDevicePixelRatio(dpr);
     }
     return pix;
 }
@@ -676,7 +681,7 @@ void ContactListViewDelegate::Private::drawContact(QPainter *painter, const QMod
 
             for (auto const &pix : pixList) {
                 rightPixs.push_back(pix);
-                rightWidths.push_back(pix.width());
+                rightWidths.push_back(logicalWidth(pix));
                 if (!allClients_)
                     break;
             }
@@ -688,7 +693,7 @@ void ContactListViewDelegate::Private::drawContact(QPainter *painter, const QMod
                 auto pix = rosterIndicator(QString("mood/%1").arg(m.typeValue()));
                 if (!pix.isNull()) {
                     rightPixs.push_back(pix);
-                    rightWidths.push_back(pix.width());
+                    rightWidths.push_back(logicalWidth(pix));
                 }
             }
         }
@@ -699,7 +704,7 @@ void ContactListViewDelegate::Private::drawContact(QPainter *painter, const QMod
                 auto pix = rosterIndicator(icon);
                 if (!pix.isNull()) {
                     rightPixs.push_back(pix);
-                    rightWidths.push_back(pix.width());
+                    rightWidths.push_back(logicalWidth(pix));
                 }
             }
         }
@@ -707,19 +712,19 @@ void ContactListViewDelegate::Private::drawContact(QPainter *painter, const QMod
         if (showTuneIcons_ && index.data(ContactListModel::TuneRole).toBool()) {
             auto pix = rosterIndicator("pep/tune");
             rightPixs.push_back(pix);
-            rightWidths.push_back(pix.width());
+            rightWidths.push_back(logicalWidth(pix));
         }
 
         if (showGeolocIcons_ && index.data(ContactListModel::GeolocationRole).toBool()) {
             auto pix = rosterIndicator("pep/geolocation");
             rightPixs.push_back(pix);
-            rightWidths.push_back(pix.width());
+            rightWidths.push_back(logicalWidth(pix));
         }
 
         if (index.data(ContactListModel::IsSecureRole).toBool()) {
             auto pix = rosterIndicator("psi/pgp");
             rightPixs.push_back(pix);
-            rightWidths.push_back(pix.width());
+            rightWidths.push_back(logicalWidth(pix));
         }
     }
 
@@ -777,9 +782,9 @@ void ContactListViewDelegate::Private::drawContact(QPainter *painter, const QMod
         } else {
             for (int i = 0; i < rightPixs.size(); i++) {
                 const QPixmap pix = rightPixs[i];
-                pepIconsRect.setRight(pepIconsRect.right() - pix.width() * PSI_HIDPI - 1); // 1 pep gap?
-                QRect targetRect(pepIconsRect.topRight(), pix.size() * PSI_HIDPI);
-                painter->drawPixmap(targetRect, pix, pix.rect());
+                pepIconsRect.setRight(pepIconsRect.right() - logicalWidth(pix) * PSI_HIDPI - 1); // 1 pep gap?
+                QRect targetRect(pepIconsRect.topRight(), pix.size() / pix.devicePixelRatio() * PSI_HIDPI);
+                painter->drawPixmap(targetRect, pix);
                 // qDebug() << r << pepIconsRect.topRight() << pix.size();
             }
         }
@@ -787,10 +787,11 @@ QString EDBSqLite::QueryStorage::getQueryString(QueryType type, bool allAccounts
             queryStr.append(" AND `date` < :date");
         else if (type == QueryDateForward)
             queryStr.append(" AND `date` >= :date");
+        // the events of the same second keep their order, so the pages don't overlap
         if (type == QueryLatest || type == QueryDateBackward)
-            queryStr.append(" ORDER BY `date` DESC");
+            queryStr.append(" ORDER BY `date` DESC, `events`.`id` DESC");
         else
-            queryStr.append(" ORDER BY `date` ASC");
+            queryStr.append(" ORDER BY `date` ASC, `events`.`id` ASC");
         queryStr.append(" LIMIT :start, :cnt;");
         break;
     case QueryRowCount:
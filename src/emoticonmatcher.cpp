@@ -0,0 +1,137 @@
+/*
+ * emoticonmatcher.cpp - finds emoticon texts in a string in one pass
+ * Copyright (C) 2020  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "emoticonmatcher.h"
+
+#include "iconset.h"
+
+#include <QQueue>
+
+EmoticonMatcher::EmoticonMatcher() { clear(); }
+
+void EmoticonMatcher::clear()
+{
+    nodes_.clear();
+    nodes_.append(Node());
+    patterns_.clear();
+}
+
+/** Compiles the texts of all the icons of \a iconsets.
+ * When the same text belongs to several icons the first one wins,
+ * in the order of \a iconsets and of the icons within them.
+ */
+void EmoticonMatcher::build(const QList<Iconset *> &iconsets)
+{
+    clear();
+
+    // trie
+    for (const Iconset *iconset : iconsets) {
+        QListIterator<PsiIcon *> it = iconset->iterator();
+        while (it.hasNext()) {
+            PsiIcon *icon = it.next();
+            for (const PsiIcon::IconText &t : icon->text()) {
+                if (t.text.isEmpty())
+                    continue;
+                int state = 0;
+                for (const QChar &c : t.text) {
+                    int next = nodes_[state].next.value(c.unicode(), -1);
+                    if (next == -1) {
+                        next = nodes_.size();
+                        nodes_[state].next.insert(c.unicode(), next);
+                        nodes_.append(Node());
+                    }
+                    state = next;
+                }
+                if (nodes_[state].pattern == -1) {
+                    nodes_[state].pattern = patterns_.size();
+                    patterns_.append({ t.text.length(), icon, icon->name() });
+                }
+            }
+        }
+    }
+
+    // failure and dictionary links, breadth first so the shorter suffixes are ready first
+    QQueue<int> queue;
+    for (int child : qAsConst(nodes_[0].next))
+        queue.enqueue(child);
+    while (!queue.isEmpty()) {
+        const int parent = queue.dequeue();
+        for (auto it = nodes_[parent].next.constBegin(); it != nodes_[parent].next.constEnd(); ++it) {
+            const int child = it.value();
+            int       fail  = nodes_[parent].fail;
+            while (fail && !nodes_[fail].next.contains(it.key()))
+                fail = nodes_[fail].fail;
+            fail               = nodes_[fail].next.value(it.key(), 0);
+            nodes_[child].fail = fail;
+            nodes_[child].dict = nodes_[fail].pattern != -1 ? fail : nodes_[fail].dict;
+            queue.enqueue(child);
+        }
+    }
+}
+
+int EmoticonMatcher::step(int state, ushort c) const
+{
+    forever {
+        auto it = nodes_[state].next.constFind(c);
+        if (it != nodes_[state].next.constEnd())
+            return it.value();
+        if (!state)
+            return 0;
+        state = nodes_[state].fail;
+    }
+}
+
+/** Returns the emoticons found in \a text, ordered and not overlapping.
+ * Like before, there must be whitespace (or the text boundary) at least on one side of an emoticon.
+ * The leftmost emoticon wins, and of the ones starting at the same position the longest.
+ */
+QList<EmoticonMatcher::Match> EmoticonMatcher::findAll(const QString &text) const
+{
+    QList<Match> ret;
+    if (isEmpty())
+        return ret;
+
+    const int    len   = text.length();
+    int          state = 0;
+    QVector<int> best(len, -1); // the longest suitable pattern starting at each position
+    for (int end = 0; end < len; ++end) {
+        state = step(state, text.at(end).unicode());
+        for (int n = nodes_[state].pattern != -1 ? state : nodes_[state].dict; n; n = nodes_[n].dict) {
+            const Pattern &p     = patterns_[nodes_[n].pattern];
+            const int      start = end - p.length + 1;
+            if (best[start] != -1 && patterns_[best[start]].length >= p.length)
+                continue;
+            const bool leftSpace  = start == 0 || text.at(start - 1).isSpace();
+            const bool rightSpace = end + 1 == len || text.at(end + 1).isSpace();
+            if (leftSpace || rightSpace)
+                best[start] = nodes_[n].pattern;
+        }
+    }
+
+    for (int i = 0; i < len;) {
+        if (best[i] == -1) {
+            ++i;
+            continue;
+        }
+        const Pattern &p = patterns_[best[i]];
+        ret.append({ i, p.length, p.icon, p.iconName });
+        i += p.length;
+    }
+    return ret;
+}
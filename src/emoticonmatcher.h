@@ -0,0 +1,76 @@
+/*
+ * emoticonmatcher.h - finds emoticon texts in a string in one pass
+ * Copyright (C) 2020  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EMOTICONMATCHER_H
+#define EMOTICONMATCHER_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class Iconset;
+class PsiIcon;
+
+/** Aho-Corasick automaton over the texts of emoticon icons.
+ * All the texts of all the enabled emoticon iconsets are compiled into one automaton,
+ * so a string is searched for every emoticon at once in a single scan instead of
+ * running each icon's regexp over it.
+ * The matcher keeps pointers to the icons, so it has to be rebuilt (or cleared)
+ * whenever the iconsets it was built from are replaced.
+ * Its data is implicitly shared, so a copy taken in the GUI thread could be used for
+ * searching in another thread (icon names are kept for that).
+ */
+class EmoticonMatcher {
+public:
+    struct Match {
+        int      pos;
+        int      length;
+        PsiIcon *icon;
+        QString  iconName; // unlike icon, safe to use while the iconsets are reloaded
+    };
+
+    EmoticonMatcher();
+
+    void build(const QList<Iconset *> &iconsets);
+    void clear();
+    bool isEmpty() const { return patterns_.isEmpty(); }
+
+    QList<Match> findAll(const QString &text) const;
+
+private:
+    struct Node {
+        QHash<ushort, int> next;
+        int                fail    = 0;
+        int                dict    = 0;  // nearest node on the fail chain having a pattern, 0 if none
+        int                pattern = -1; // pattern ending at this node
+    };
+    struct Pattern {
+        int      length;
+        PsiIcon *icon;
+        QString  iconName;
+    };
+
+    int step(int state, ushort c) const;
+
+    QVector<Node>    nodes_; // nodes_[0] is the root
+    QVector<Pattern> patterns_;
+};
+
+#endif // EMOTICONMATCHER_H
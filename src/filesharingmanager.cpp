@@ -242,7 +242,7 @@ void FileSharingManager::fillMessageView(MessageView &mv, const Message &m, PsiA
                     QString::fromLatin1("<share id=\"%1\" text=\"%2\"/>").arg(item->sums()[0].toString(), refText));
 
                 // add text before reference
-                htmlDesc += TextUtil::linkify(TextUtil::plain2rich(desc.mid(lastEnd, r.begin() - lastEnd)));
+                htmlDesc += TextUtil::plain2richLinkified(desc.mid(lastEnd, r.begin() - lastEnd));
                 htmlDesc += shareStr; // something instead of link
                 lastEnd = r.end() + 1;
             } else {
@@ -250,7 +250,7 @@ void FileSharingManager::fillMessageView(MessageView &mv, const Message &m, PsiA
             }
         }
         if (lastEnd < desc.size()) {
-            htmlDesc += TextUtil::linkify(TextUtil::plain2rich(desc.mid(lastEnd, desc.size() - lastEnd)));
+            htmlDesc += TextUtil::plain2richLinkified(desc.mid(lastEnd, desc.size() - lastEnd));
         }
         htmlDesc += tailReferences;
         // qDebug() << "HTML:" << htmlDesc;
@@ -226,7 +226,7 @@ public:
 
         int sumWidth = 0;
         for (const QPixmap &pix : rightPixs) {
-            sumWidth += pix.width();
+            sumWidth += qRound(pix.width() / pix.devicePixelRatio());
         }
         sumWidth += rightPixs.count();
 
@@ -245,11 +245,11 @@ public:
         QRect iconRect(rect);
         for (int i = 0; i < rightPixs.size(); i++) {
             const QPixmap &pix = rightPixs[i];
-            auto           pmr = pix.rect();
+            QRect          pmr(QPoint(), pix.size() / pix.devicePixelRatio());
             pmr.moveCenter(iconRect.center());
             pmr.moveRight(iconRect.right());
             mp->drawPixmap(pmr, pix);
-            iconRect.setRight(iconRect.right() - pix.width() - 1);
+            iconRect.setRight(iconRect.right() - pmr.width() - 1);
         }
     }
 
@@ -490,6 +490,7 @@ void GCUserModel::removeEntry(const QString &nick)
     if (index.isValid()) {
         beginRemoveRows(index.parent(), index.row(), index.row());
         contacts[index.parent().row()].removeAt(index.row());
+        _nickIndex.remove(nick);
         endRemoveRows();
     }
     // TODO don't remove groups. just set display text to "" in data() (ex GCUserViewGroupItem::updateText)
@@ -570,6 +571,7 @@ void GCUserModel::updateEntry(const QString &nick, const Status &s)
             contact->status = s;
             contact->avatar = _account->avatarFactory()->getMucAvatar(_selfJid.withResource(nick));
             contacts[newGroupRole].insert(insertRowNum, contact);
+            _nickIndex.insert(nick);
             if (nick == _selfJid.resource()) {
                 _selfContact = contact;
             }
@@ -593,6 +595,7 @@ void GCUserModel::clear()
             endRemoveRows();
         }
     }
+    _nickIndex.clear();
 }
 
 void GCUserModel::updateAll()
@@ -638,17 +641,7 @@ GCUserModel::MUCContact *GCUserModel::findEntry(const QString &nick) const
     return static_cast<GCUserModel::MUCContact *>(findIndex(nick).internalPointer());
 }
 
-QStringList GCUserModel::nickList() const
-{
-    QStringList nicks;
-    for (int gr = 0; gr < LastGroupRole; gr++) {
-        for (auto const &c : contacts[gr]) {
-            nicks << c->name;
-        }
-    }
-    nicks.sort(Qt::CaseInsensitive);
-    return nicks;
-}
+QStringList GCUserModel::nickList() const { return _nickIndex.words(); }
 
 //----------------------------------------------------------------------------
 // GCUserView
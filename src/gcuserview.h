@@ -21,6 +21,7 @@
 #ifndef GCUSERVIEW_H
 #define GCUSERVIEW_H
 
+#include "completionindex.h"
 #include "xmpp_status.h"
 
 #include <QAbstractItemModel>
@@ -68,6 +69,8 @@ public:
     MUCContact *selfContact() const;
     void        updateAvatar(const QString &nick);
 
+    const CompletionIndex &nickIndex() const { return _nickIndex; }
+
     // reimplemented
     QModelIndex     index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
     QVariant        data(const QModelIndex &index, int role = Qt::DisplayRole) const;
@@ -87,6 +90,7 @@ private:
 
 private:
     QList<MUCContact::Ptr> contacts[LastGroupRole]; // splitted into groups
+    CompletionIndex        _nickIndex;              // all nicks, kept sorted for completion
 
     PsiAccount *    _account;
     Jid             _selfJid;
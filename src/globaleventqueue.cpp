@@ -34,23 +34,20 @@ const QList<int> &GlobalEventQueue::ids() const { return ids_; }
 
 PsiEvent::Ptr GlobalEventQueue::peek(int id) const
 {
-    Q_ASSERT(ids_.contains(id));
-    for (EventItem *item : items_)
-        if (item->id() == id)
-            return item->event();
-    return PsiEvent::Ptr();
+    Q_ASSERT(items_.contains(id));
+    EventItem *item = items_.value(id);
+    return item ? item->event() : PsiEvent::Ptr();
 }
 
 void GlobalEventQueue::enqueue(EventItem *item)
 {
     Q_ASSERT(item);
-    Q_ASSERT(!ids_.contains(item->id()));
-    if (!item || ids_.contains(item->id()))
+    Q_ASSERT(!items_.contains(item->id()));
+    if (!item || items_.contains(item->id()))
         return;
 
     ids_.append(item->id());
-    items_.append(item);
-    Q_ASSERT(ids_.contains(item->id()));
+    items_.insert(item->id(), item);
 
     emit queueChanged();
 }
@@ -58,13 +55,12 @@ void GlobalEventQueue::enqueue(EventItem *item)
 void GlobalEventQueue::dequeue(EventItem *item)
 {
     Q_ASSERT(item);
-    Q_ASSERT(ids_.contains(item->id()));
-    if (!item || !ids_.contains(item->id()))
+    Q_ASSERT(items_.contains(item->id()));
+    if (!item || !items_.contains(item->id()))
         return;
 
-    ids_.removeAll(item->id());
-    items_.removeAll(item);
-    Q_ASSERT(!ids_.contains(item->id()));
+    ids_.removeOne(item->id());
+    items_.remove(item->id());
 
     emit queueChanged();
 }
@@ -22,6 +22,7 @@
 
 #include "psievent.h"
 
+#include <QHash>
 #include <QObject>
 
 class GlobalEventQueue : public QObject {
@@ -46,8 +47,8 @@ private:
     GlobalEventQueue();
 
     static GlobalEventQueue *instance_;
-    QList<int>               ids_;
-    QList<EventItem *>       items_;
+    QList<int>               ids_;   // in queue order
+    QHash<int, EventItem *>  items_; // by id
     friend class EventQueue;
 };
 
@@ -38,6 +38,7 @@
 #include "lastactivitytask.h"
 #include "mcmdmanager.h"
 #include "mcmdsimplesite.h"
+#include "messageformatter.h"
 #include "messageview.h"
 #include "msgmle.h"
 #include "mucconfigdlg.h"
@@ -261,6 +262,8 @@ public:
     bool trackBar;
     bool tabmode;
 
+    MessageFormatter *formatter; // keeps the order of messages while large ones are formatted
+
 public:
     ChatEdit *mle() const { return dlg->ui_.mle->chatEdit(); }
     ChatView *te_log() const { return dlg->ui_.log; }
@@ -487,7 +490,7 @@ join <channel>{,<channel>} [pass{,<pass>}
             } else if (item == 1) {
                 if (partcommand[0] == "version" || partcommand[0] == "idle" || partcommand[0] == "kick"
                     || partcommand[0] == "ban") {
-                    all = usersModel->nickList();
+                    return usersModel->nickIndex().startingWith(query);
                 } else if (partcommand[0] == "topic") {
                     LanguageManager::LangId id;
                     all << dlg->d->subjectMap.value(id);
@@ -607,14 +610,12 @@ public:
             if (p_->mCmdSite.isActive()) {
                 return mCmdList_;
             }
-            QStringList suggestedNicks;
-            QStringList nicks = allNicks();
-
-            QString postAdd = atStart_ ? nickSeparator + " " : "";
+            QStringList suggestedNicks = p_->usersModel->nickIndex().startingWith(toComplete_);
 
-            for (const QString &nick : nicks) {
-                if (nick.left(toComplete_.length()).toLower() == toComplete_.toLower()) {
-                    suggestedNicks << nick + postAdd;
+            if (atStart_) {
+                const QString postAdd = nickSeparator + " ";
+                for (QString &nick : suggestedNicks) {
+                    nick += postAdd;
                 }
             }
             return suggestedNicks;
@@ -642,7 +643,7 @@ public:
             return all;
         };
 
-        QStringList allNicks() { return p_->dlg->d->usersModel->nickList(); }
+        QStringList allNicks() { return p_->usersModel->nickList(); }
 
         QStringList mCmdList_;
 
@@ -833,6 +834,8 @@ GCMainDlg::GCMainDlg(PsiAccount *pa, const Jid &j, TabManager *tabManager) : Tab
     d       = new Private(this);
     d->self = d->prev_self = j.resource();
     d->mucNameSource       = Private::TitleNone;
+    d->formatter           = new MessageFormatter(this);
+    connect(d->formatter, &MessageFormatter::ready, this, &GCMainDlg::displayMessage);
     account()->dialogRegister(this, jid());
     connect(account(), SIGNAL(updatedActivity()), SLOT(pa_updatedActivity()));
     d->mucManager = new MUCManager(account(), jid());
@@ -1506,7 +1509,11 @@ void GCMainDlg::doShowInfo()
     dlg->show();
 }
 
-void GCMainDlg::doClear() { ui_.log->clear(); }
+void GCMainDlg::doClear()
+{
+    d->formatter->clear();
+    ui_.log->clear();
+}
 
 void GCMainDlg::doClearButton()
 {
@@ -2071,8 +2078,7 @@ void GCMainDlg::message(const Message &_m, const PsiEvent::Ptr &e)
     }
 
     if (!topic.isNull()) {
-        QString subjectTooltip = TextUtil::plain2rich(topic);
-        subjectTooltip         = TextUtil::linkify(subjectTooltip);
+        QString subjectTooltip = TextUtil::plain2richLinkified(topic);
         if (options->getOption("options.ui.emoticons.use-emoticons").toBool()) {
             subjectTooltip = TextUtil::emoticonify(subjectTooltip);
         }
@@ -2177,7 +2183,10 @@ void GCMainDlg::appendSysMsg(const QString &str, bool alert)
     dispatchMessage(mv);
 }
 
-void GCMainDlg::dispatchMessage(const MessageView &mv)
+void GCMainDlg::dispatchMessage(const MessageView &mv) { d->formatter->append(mv); }
+
+// messages come here in the order of dispatchMessage() when they are ready to be displayed
+void GCMainDlg::displayMessage(const MessageView &mv)
 {
     if (d->trackBar && !mv.isLocal() && !mv.isSpooled())
         d->doTrackBar();
@@ -2218,7 +2227,7 @@ void GCMainDlg::appendMessage(const Message &m, bool alert)
         && !m.html().text().isEmpty()) {
         mv.setHtml(m.html().toString("span"));
     } else {
-        mv.setPlainText(m.body());
+        mv.deferPlainText(m.body());
     }
     if (!PsiOptions::instance()->getOption("options.ui.muc.use-highlighting").toBool())
         alert = false;
@@ -156,6 +156,7 @@ private:
 
     void doAlert();
     void appendMessage(const Message &, bool);
+    void displayMessage(const MessageView &mv);
     void setLooks();
     void setToolbuttons();
 
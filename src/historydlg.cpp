@@ -536,7 +536,7 @@ void DisplayProxy::displayResult(const EDBResult &r, int dir)
             QString           from = getNick(e->account(), e->from());
             MessageEvent::Ptr me   = e.staticCast<MessageEvent>();
             QString           msg  = me->message().body();
-            msg                    = TextUtil::linkify(TextUtil::plain2rich(msg));
+            msg                    = TextUtil::plain2richLinkified(msg);
 
             if (emoticons)
                 msg = TextUtil::emoticonify(msg);
@@ -146,12 +146,15 @@ void PopupActionButton::pixmapUpdated()
     if (icon) {
         auto fs = fontInfo().pixelSize();
         pix     = icon->pixmap(QSize(int(fs * BiggerTextIconK + .5), int(fs * BiggerTextIconK + .5)));
-        if (pix.height() > fs * HugeIconButtonK) {
-            pix = pix.scaledToHeight(int(fs * BiggerTextIconK + .5), Qt::SmoothTransformation);
+
+        qreal dpr = pix.devicePixelRatio();
+        if (pix.height() > fs * HugeIconButtonK * dpr) {
+            pix = pix.scaledToHeight(int((fs * BiggerTextIconK + .5) * dpr), Qt::SmoothTransformation);
+            pix.setDevicePixelRatio(dpr);
         }
     }
     QPushButton::setIcon(pix);
-    QPushButton::setIconSize(pix.size());
+    QPushButton::setIconSize(pix.size() / pix.devicePixelRatio());
 }
 
 void PopupActionButton::paintEvent(QPaintEvent *p)
@@ -0,0 +1,93 @@
+/*
+ * messageformatter.cpp - formats large messages outside of the GUI thread
+ * Copyright (C) 2020  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "messageformatter.h"
+
+#include <QtConcurrentRun>
+
+MessageFormatter::MessageFormatter(QObject *parent) : QObject(parent) { }
+
+void MessageFormatter::append(const MessageView &mv)
+{
+    const bool large = mv.isLarge();
+    if (!large && queue_.isEmpty()) {
+        emit ready(mv);
+        return;
+    }
+
+    Entry e { QSharedPointer<MessageView>::create(mv), nullptr, false };
+    if (large) {
+        // the options are taken here, the job touches only its own copy of the view.
+        // it keeps the copy alive by itself, so there is nothing to wait for if we are deleted first
+        auto job     = e.mv;
+        auto options = MessageView::FormatOptions::current();
+        e.watcher    = new QFutureWatcher<void>(this);
+        connect(e.watcher, &QFutureWatcher<void>::finished, this, &MessageFormatter::flush);
+        e.watcher->setFuture(QtConcurrent::run([job, options]() { job->format(options); }));
+    }
+    queue_.append(e);
+}
+
+/**
+ * Clears the delivery receipt flag of a queued message, so a receipt overtaking
+ * its message isn't lost. Returns true if the message was found.
+ */
+bool MessageFormatter::markReceived(const QString &id)
+{
+    for (auto it = queue_.rbegin(); it != queue_.rend(); ++it) {
+        if (it->mv->messageId() == id) {
+            // the job may still be formatting the view, so it's patched once it's handed back
+            if (it->watcher && !it->watcher->isFinished())
+                it->received = true;
+            else
+                it->mv->setAwaitingReceipt(false);
+            return true;
+        }
+    }
+    return false;
+}
+
+// drops the queued views. the jobs in progress finish on their own copies
+void MessageFormatter::clear()
+{
+    for (const Entry &e : queue_) {
+        if (e.watcher) {
+            e.watcher->disconnect(this);
+            e.watcher->deleteLater();
+        }
+    }
+    queue_.clear();
+}
+
+// hands back everything up to the first view still being formatted
+void MessageFormatter::flush()
+{
+    while (!queue_.isEmpty()) {
+        const Entry e = queue_.first();
+        if (e.watcher) {
+            if (!e.watcher->isFinished())
+                return;
+            e.watcher->deleteLater();
+        }
+        queue_.removeFirst();
+        if (e.received)
+            e.mv->setAwaitingReceipt(false);
+        emit ready(*e.mv);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * messageformatter.h - formats large messages outside of the GUI thread
+ * Copyright (C) 2020  Psi Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MESSAGEFORMATTER_H
+#define MESSAGEFORMATTER_H
+
+#include "messageview.h"
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+
+/** Ordered queue of message views on their way to a chat view.
+ * Large messages (see MessageView::isLarge()) are formatted in the global thread pool,
+ * so pasting or receiving a huge text doesn't block the GUI. All the views are handed back
+ * by ready() in the order they were appended, the ones after a large message wait for it.
+ * When nothing is being formatted small views are handed back right away.
+ */
+class MessageFormatter : public QObject {
+    Q_OBJECT
+public:
+    explicit MessageFormatter(QObject *parent = nullptr);
+
+    void append(const MessageView &mv);
+    bool markReceived(const QString &id);
+    void clear();
+    bool isBusy() const { return !queue_.isEmpty(); }
+
+signals:
+    void ready(const MessageView &mv);
+
+private slots:
+    void flush();
+
+private:
+    struct Entry {
+        QSharedPointer<MessageView> mv;
+        QFutureWatcher<void> *      watcher;  // formatting in progress or nullptr
+        bool                        received; // receipt arrived while formatting. see markReceived()
+    };
+
+    QList<Entry> queue_;
+};
+
+#endif // MESSAGEFORMATTER_H
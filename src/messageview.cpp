@@ -19,7 +19,9 @@
 
 #include "messageview.h"
 
+#include "coloropt.h"
 #include "common.h"
+#include "psiiconset.h"
 #include "psioptions.h"
 #include "textutil.h"
 
@@ -108,19 +110,34 @@ MessageView MessageView::statusMessage(const QString &nick, int status, const QS
 
 void MessageView::setPlainText(const QString &text)
 {
+    _plainText.clear(); // replaces the deferred text too
     if (!text.isEmpty()) {
         if (_type == Message) {
             setEmote(text.startsWith(me_cmd));
         }
-        _text = TextUtil::plain2rich(text);
-        if (_type == Message) {
-            _text = TextUtil::linkify(_text);
-        }
+        _text = _type == Message ? TextUtil::plain2richLinkified(text) : TextUtil::plain2rich(text);
     }
 }
 
+/**
+ * Like setPlainText(), but a large \a text is only converted to rich text by format().
+ * Until then text() is empty. Used for the messages going through MessageFormatter.
+ */
+void MessageView::deferPlainText(const QString &text)
+{
+    if (text.length() < largeTextSize) {
+        setPlainText(text);
+        return;
+    }
+    if (_type == Message) {
+        setEmote(text.startsWith(me_cmd));
+    }
+    _plainText = text;
+}
+
 void MessageView::setHtml(const QString &text)
 {
+    _plainText.clear();
     if (_type == Message) {
         QString str = TextUtil::rich2plain(text).trimmed();
         setEmote(str.startsWith(me_cmd));
@@ -132,7 +149,37 @@ void MessageView::setHtml(const QString &text)
     _text = text;
 }
 
-QString MessageView::formattedText() const
+MessageView::FormatOptions MessageView::FormatOptions::current()
+{
+    FormatOptions o;
+    o.emoticons        = PsiOptions::instance()->getOption("options.ui.emoticons.use-emoticons").toBool();
+    o.legacyFormatting = PsiOptions::instance()->getOption("options.ui.chat.legacy-formatting").toBool();
+    o.linkColor        = ColorOpt::instance()->color("options.ui.look.colors.messages.link");
+    if (o.emoticons)
+        o.emoticonMatcher = PsiIconset::instance()->emoticonMatcher();
+    return o;
+}
+
+/**
+ * Converts the deferred plain text and prepares formattedText() with the given \a options.
+ * Doesn't touch anything but this message view, so it's safe to call it outside of the GUI thread.
+ */
+void MessageView::format(const FormatOptions &options)
+{
+    if (!_plainText.isNull()) {
+        _text = _type == Message ? TextUtil::plain2richLinkified(_plainText, options.linkColor)
+                                 : TextUtil::plain2rich(_plainText);
+        _plainText.clear();
+    }
+    _formattedText = formatText(options);
+}
+
+bool MessageView::isLarge() const
+{
+    return _type == Message && (needsFormatting() || _text.length() >= largeTextSize);
+}
+
+QString MessageView::formatText(const FormatOptions &options) const
 {
     QString txt = _text;
 
@@ -140,19 +187,25 @@ QString MessageView::formattedText() const
         int cmd = txt.indexOf(me_cmd);
         txt     = txt.remove(cmd, me_cmd.length());
     }
-    if (PsiOptions::instance()->getOption("options.ui.emoticons.use-emoticons").toBool())
-        txt = TextUtil::emoticonify(txt);
-    if (PsiOptions::instance()->getOption("options.ui.chat.legacy-formatting").toBool())
+    if (options.emoticons)
+        txt = TextUtil::emoticonify(txt, options.emoticonMatcher);
+    if (options.legacyFormatting)
         txt = TextUtil::legacyFormat(txt);
 
     return txt;
 }
 
+QString MessageView::formattedText() const
+{
+    if (!_formattedText.isNull())
+        return _formattedText;
+    return formatText(FormatOptions::current());
+}
+
 QString MessageView::formattedUserText() const
 {
     if (!_userText.isEmpty()) {
-        QString text = TextUtil::plain2rich(_userText);
-        text         = TextUtil::linkify(text);
+        QString text = TextUtil::plain2richLinkified(_userText);
         if (PsiOptions::instance()->getOption("options.ui.emoticons.use-emoticons").toBool())
             text = TextUtil::emoticonify(text);
         if (PsiOptions::instance()->getOption("options.ui.chat.legacy-formatting").toBool())
@@ -20,9 +20,11 @@
 #ifndef MESSAGEVIEW_H
 #define MESSAGEVIEW_H
 
+#include "emoticonmatcher.h"
 #include "filesharingitem.h"
 #include "xmpp_message.h"
 
+#include <QColor>
 #include <QDateTime>
 #include <QVariantMap>
 
@@ -62,6 +64,19 @@ public:
     };
     Q_DECLARE_FLAGS(Flags, Flag)
 
+    // settings the formatting depends on. Taken in the GUI thread so format() could run in any thread
+    struct FormatOptions {
+        bool            emoticons        = false;
+        bool            legacyFormatting = false;
+        QColor          linkColor;
+        EmoticonMatcher emoticonMatcher;
+
+        static FormatOptions current();
+    };
+
+    // texts at least that long are better formatted outside of the GUI thread. see MessageFormatter
+    static const int largeTextSize = 16 * 1024;
+
     MessageView(Type);
 
     static MessageView fromPlainText(const QString &, Type);
@@ -89,7 +104,11 @@ public:
     inline void           setUserText(const QString &text) { _userText = text; }
 
     void    setPlainText(const QString &);
+    void    deferPlainText(const QString &);
     void    setHtml(const QString &);
+    void    format(const FormatOptions &options);
+    bool    needsFormatting() const { return !_plainText.isNull(); }
+    bool    isLarge() const;
     QString formattedText() const;
     QString formattedUserText() const;
     bool    hasStatus() const;
@@ -135,6 +154,8 @@ public:
     QVariantMap toVariantMap(bool isMuc, bool formatted = false) const;
 
 private:
+    QString formatText(const FormatOptions &options) const;
+
     Type                     _type;
     Flags                    _flags;
     int                      _status;
@@ -142,8 +163,10 @@ private:
     QString                  _messageId;
     QString                  _userId;   // TODO: convert to XMPP::Jid, only used in message corrections as of now
     QString                  _nick;     // rich / as is
-    QString                  _text;     // always rich (plain text converted to rich)
-    QString                  _userText; // rich
+    QString                  _text;          // always rich (plain text converted to rich)
+    QString                  _plainText;     // deferred plain text, converted to _text by format()
+    QString                  _formattedText; // _text prepared by format(), if it was called
+    QString                  _userText;      // rich
     QDateTime                _dateTime;
     QMap<QString, QString>   _urls;
     QString                  _replaceId;
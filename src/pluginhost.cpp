@@ -291,6 +291,9 @@ bool PluginHost::load()
 
                 hasToolBarButton_       = qobject_cast<ToolbarIconAccessor *>(plugin_) ? true : false;
                 hasGCToolBarButton_     = qobject_cast<GCToolbarIconAccessor *>(plugin_) ? true : false;
+                stanzaFilter_           = qobject_cast<StanzaFilter *>(plugin_);
+                eventFilter_            = qobject_cast<EventFilter *>(plugin_);
+                hasIqFilter_            = qobject_cast<IqFilter *>(plugin_) ? true : false;
                 PluginInfoProvider *pip = qobject_cast<PluginInfoProvider *>(plugin_);
                 if (pip) {
                     hasInfo_    = true;
@@ -331,8 +334,11 @@ bool PluginHost::unload()
         } else if (loader_->unload()) {
             // delete plugin_; // loader will delete it automatically
             delete iconset_;
-            iconset_   = nullptr;
-            connected_ = false;
+            iconset_      = nullptr;
+            connected_    = false;
+            stanzaFilter_ = nullptr;
+            eventFilter_  = nullptr;
+            hasIqFilter_  = false;
             delete loader_;
             plugin_ = nullptr;
             loader_ = nullptr;
@@ -551,6 +557,23 @@ bool PluginHost::disable()
  */
 bool PluginHost::isEnabled() const { return enabled_; }
 
+/**
+ * \brief Returns true if plugin wants to see incoming xml.
+ *
+ * That is, if it implements StanzaFilter or IqFilter.
+ */
+bool PluginHost::hasIncomingXmlFilter() const { return stanzaFilter_ || hasIqFilter_; }
+
+/**
+ * \brief Returns true if plugin implements StanzaFilter.
+ */
+bool PluginHost::hasOutgoingXmlFilter() const { return stanzaFilter_; }
+
+/**
+ * \brief Returns true if plugin implements EventFilter.
+ */
+bool PluginHost::hasEventFilter() const { return eventFilter_; }
+
 //-- for StanzaFilter and IqNamespaceFilter -------------------------
 
 /**
@@ -570,8 +593,7 @@ bool PluginHost::incomingXml(int account, const QDomElement &e)
     bool handled = false;
 
     // try stanza filter first
-    StanzaFilter *sf = qobject_cast<StanzaFilter *>(plugin_);
-    if (sf && sf->incomingStanza(account, e)) {
+    if (stanzaFilter_ && stanzaFilter_->incomingStanza(account, e)) {
         handled = true;
     }
     // try iq filters
@@ -608,11 +630,13 @@ bool PluginHost::incomingXml(int account, const QDomElement &e)
                 }
             }
 
-            // regex filters
-            QMapIterator<QRegExp, IqNamespaceFilter *> i(iqNsxFilters_);
-            while (!handled && i.hasNext()) {
-                if (i.key().indexIn(ns) >= 0 && (i.value()->*handler)(account, e)) {
-                    handled = true;
+            // regex filters. most namespaces are rejected by the combined matcher at once
+            if (!handled && !iqNsxFilters_.isEmpty() && iqNsxMatcher_.indexIn(ns) >= 0) {
+                for (IqNamespaceFilter *f : iqNsxRoute(ns)) {
+                    if ((f->*handler)(account, e)) {
+                        handled = true;
+                        break;
+                    }
                 }
             }
         }
@@ -623,9 +647,8 @@ bool PluginHost::incomingXml(int account, const QDomElement &e)
 
 bool PluginHost::outgoingXml(int account, QDomElement &e)
 {
-    bool          handled = false;
-    StanzaFilter *ef      = qobject_cast<StanzaFilter *>(plugin_);
-    if (ef && ef->outgoingStanza(account, e)) {
+    bool handled = false;
+    if (stanzaFilter_ && stanzaFilter_->outgoingStanza(account, e)) {
         handled = true;
     }
     return handled;
@@ -647,9 +670,8 @@ bool PluginHost::outgoingXml(int account, QDomElement &e)
  */
 bool PluginHost::processEvent(int account, QDomElement &e)
 {
-    bool         handled = false;
-    EventFilter *ef      = qobject_cast<EventFilter *>(plugin_);
-    if (ef && ef->processEvent(account, e)) {
+    bool handled = false;
+    if (eventFilter_ && eventFilter_->processEvent(account, e)) {
         handled = true;
     }
     return handled;
@@ -672,9 +694,8 @@ bool PluginHost::processEvent(int account, QDomElement &e)
  */
 bool PluginHost::processMessage(int account, const QString &jidFrom, const QString &body, const QString &subject)
 {
-    bool         handled = false;
-    EventFilter *ef      = qobject_cast<EventFilter *>(plugin_);
-    if (ef && ef->processMessage(account, jidFrom, body, subject)) {
+    bool handled = false;
+    if (eventFilter_ && eventFilter_->processMessage(account, jidFrom, body, subject)) {
         handled = true;
     }
     return handled;
@@ -683,9 +704,8 @@ bool PluginHost::processMessage(int account, const QString &jidFrom, const QStri
 bool PluginHost::processOutgoingMessage(int account, const QString &jidTo, QString &body, const QString &type,
                                         QString &subject)
 {
-    bool         handled = false;
-    EventFilter *ef      = qobject_cast<EventFilter *>(plugin_);
-    if (ef && ef->processOutgoingMessage(account, jidTo, body, type, subject)) {
+    bool handled = false;
+    if (eventFilter_ && eventFilter_->processOutgoingMessage(account, jidTo, body, type, subject)) {
         handled = true;
     }
     return handled;
@@ -693,9 +713,8 @@ bool PluginHost::processOutgoingMessage(int account, const QString &jidTo, QStri
 
 void PluginHost::logout(int account)
 {
-    EventFilter *ef = qobject_cast<EventFilter *>(plugin_);
-    if (ef) {
-        ef->logout(account);
+    if (eventFilter_) {
+        eventFilter_->logout(account);
     }
 }
 
@@ -822,6 +841,7 @@ void PluginHost::addIqNamespaceFilter(const QRegExp &ns, IqNamespaceFilter *filt
 #endif
     } else {
         iqNsxFilters_.insert(ns, filter);
+        updateIqNsxMatcher();
     }
 }
 
@@ -844,7 +864,77 @@ void PluginHost::removeIqNamespaceFilter(const QString &ns, IqNamespaceFilter *f
  */
 void PluginHost::removeIqNamespaceFilter(const QRegExp &ns, IqNamespaceFilter *filter)
 {
-    iqNsxFilters_.remove(ns, filter);
+    if (iqNsxFilters_.remove(ns, filter))
+        updateIqNsxMatcher();
+}
+
+/**
+ * \brief Compiles the regex namespace filters into one matcher.
+ *
+ * The matcher accepts the namespaces matched by any of the filters, so other iqs
+ * are passed by with a single match. Filters which can't be combined
+ * (wildcards, back references, mixed case sensitivity) make it accept everything.
+ */
+void PluginHost::updateIqNsxMatcher()
+{
+    iqNsxRoutes_.clear();
+
+    QStringList         patterns;
+    Qt::CaseSensitivity cs       = Qt::CaseSensitive;
+    bool                combined = true;
+    for (const QRegExp &rx : iqNsxFilters_.uniqueKeys()) {
+        if (!rx.isValid())
+            continue; // never matches anyway
+        if (!patterns.isEmpty() && rx.caseSensitivity() != cs) {
+            combined = false;
+            break;
+        }
+        cs = rx.caseSensitivity();
+
+        switch (rx.patternSyntax()) {
+        case QRegExp::RegExp:
+        case QRegExp::RegExp2:
+            // back references would refer to the wrong groups once combined
+            if (rx.pattern().contains(QRegExp("\\\\[1-9]")))
+                combined = false;
+            else
+                patterns << QString("(?:%1)").arg(rx.pattern());
+            break;
+        case QRegExp::FixedString:
+            patterns << QRegExp::escape(rx.pattern());
+            break;
+        default:
+            combined = false;
+            break;
+        }
+        if (!combined)
+            break;
+    }
+
+    iqNsxMatcher_ = combined ? QRegExp(patterns.join('|'), cs) : QRegExp();
+}
+
+/**
+ * \brief Returns the regex namespace filters matching \a ns, in the order they are tried.
+ *
+ * The result is remembered until the filters change.
+ */
+QList<IqNamespaceFilter *> PluginHost::iqNsxRoute(const QString &ns)
+{
+    auto it = iqNsxRoutes_.constFind(ns);
+    if (it == iqNsxRoutes_.constEnd()) {
+        // namespaces come from the network, so don't let them pile up
+        if (iqNsxRoutes_.size() >= 256)
+            iqNsxRoutes_.clear();
+
+        QList<IqNamespaceFilter *> filters;
+        for (auto i = iqNsxFilters_.constBegin(); i != iqNsxFilters_.constEnd(); ++i) {
+            if (i.key().indexIn(ns) >= 0)
+                filters << i.value();
+        }
+        it = iqNsxRoutes_.insert(ns, filters);
+    }
+    return *it;
 }
 
 //-- OptionAccessor -------------------------------------------------
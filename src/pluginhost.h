@@ -31,16 +31,19 @@
 #include "webkitaccessinghost.h"
 
 #include <QDomElement>
+#include <QHash>
 #include <QMultiMap>
 #include <QPointer>
 #include <QRegExp>
 #include <QTextEdit>
 #include <QVariant>
 
+class EventFilter;
 class IqNamespaceFilter;
 class PluginManager;
 class QPluginLoader;
 class QWidget;
+class StanzaFilter;
 namespace PsiMedia {
 class Provider;
 }
@@ -103,6 +106,11 @@ public:
     bool disable();
     bool isEnabled() const;
 
+    // hooks implemented by the loaded plugin. see PluginManager::updateDispatchLists()
+    bool hasIncomingXmlFilter() const;
+    bool hasOutgoingXmlFilter() const;
+    bool hasEventFilter() const;
+
     // for StanzaFilter and IqNamespaceFilter
     bool incomingXml(int account, const QDomElement &e);
     bool outgoingXml(int account, QDomElement &e);
@@ -271,7 +279,9 @@ public:
     void setMediaProvider(PsiMedia::Provider *provider) override;
 
 private:
-    bool loadPlugin(QObject *pluginObject);
+    bool                       loadPlugin(QObject *pluginObject);
+    void                       updateIqNsxMatcher();
+    QList<IqNamespaceFilter *> iqNsxRoute(const QString &ns);
 
 signals:
     void enabled();
@@ -294,6 +304,9 @@ private:
     Iconset *         iconset_            = nullptr;
     bool              hasToolBarButton_   = false;
     bool              hasGCToolBarButton_ = false;
+    StanzaFilter *    stanzaFilter_       = nullptr; // interfaces of plugin_, resolved once it's loaded
+    EventFilter *     eventFilter_        = nullptr;
+    bool              hasIqFilter_        = false;
 
     bool    valid_     = false;
     bool    connected_ = false;
@@ -301,10 +314,12 @@ private:
     bool    hasInfo_   = false;
     QString infoString_;
 
-    QMultiMap<QString, IqNamespaceFilter *> iqNsFilters_;
-    QMultiMap<QRegExp, IqNamespaceFilter *> iqNsxFilters_;
-    QList<QVariantHash>                     buttons_;
-    QList<QVariantHash>                     gcbuttons_;
+    QMultiHash<QString, IqNamespaceFilter *>   iqNsFilters_;
+    QMultiMap<QRegExp, IqNamespaceFilter *>    iqNsxFilters_;
+    QRegExp                                    iqNsxMatcher_; // all of iqNsxFilters_ at once
+    QHash<QString, QList<IqNamespaceFilter *>> iqNsxRoutes_;  // namespace => matching iqNsxFilters_
+    QList<QVariantHash>                        buttons_;
+    QList<QVariantHash>                        gcbuttons_;
 
     QList<QVariantHash> accMenu_;
     QList<QVariantHash> contactMenu_;
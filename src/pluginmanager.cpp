@@ -133,6 +133,8 @@ QList<PluginHost *> PluginManager::updatePluginsList()
                             [this, shortName = host->shortName()]() { emit pluginEnabled(shortName); });
                     connect(host, &PluginHost::disabled, this,
                             [this, shortName = host->shortName()]() { emit pluginDisabled(shortName); });
+                    connect(host, &PluginHost::enabled, this, &PluginManager::updateDispatchLists);
+                    connect(host, &PluginHost::disabled, this, &PluginManager::updateDispatchLists);
                     if (host->isValid() && !hosts_.contains(host->shortName())) {
                         hosts_[host->shortName()] = host;
                         pluginByFile_[file]       = host;
@@ -203,6 +205,28 @@ void PluginManager::loadPluginIfEnabled(PluginHost *plugin)
     }
 }
 
+/**
+ * Rebuilds the lists of plugins the stanzas and events are passed to,
+ * so they only visit the plugins implementing the hook.
+ * Called whenever a plugin gets enabled or disabled.
+ */
+void PluginManager::updateDispatchLists()
+{
+    incomingXmlFilters_.clear();
+    outgoingXmlFilters_.clear();
+    eventFilters_.clear();
+    for (PluginHost *host : pluginsByPriority_) {
+        if (!host->isEnabled())
+            continue;
+        if (host->hasIncomingXmlFilter())
+            incomingXmlFilters_.append(host);
+        if (host->hasOutgoingXmlFilter())
+            outgoingXmlFilters_.append(host);
+        if (host->hasEventFilter())
+            eventFilters_.append(host);
+    }
+}
+
 /**
  * Called when an option changes to load or unload a plugin if it's a plugin
  * option
@@ -406,9 +430,12 @@ void PluginManager::setShortcuts()
 bool PluginManager::processMessage(PsiAccount *account, const QString &jidFrom, const QString &body,
                                    const QString &subject)
 {
-    bool handled = false;
-    for (PluginHost *host : pluginsByPriority_) {
-        if (host->processMessage(accountIds_.id(account), jidFrom, body, subject)) {
+    // the list is copied (shared, not allocated), so it stays intact if a plugin gets disabled meanwhile
+    bool                      handled = false;
+    const int                 acc_id  = accountIds_.id(account);
+    const QList<PluginHost *> hosts   = eventFilters_;
+    for (PluginHost *host : hosts) {
+        if (host->processMessage(acc_id, jidFrom, body, subject)) {
             handled = true;
             break;
         }
@@ -428,9 +455,10 @@ bool PluginManager::processMessage(PsiAccount *account, const QString &jidFrom,
  */
 bool PluginManager::processEvent(PsiAccount *account, QDomElement &event)
 {
-    bool      handled = false;
-    const int acc_id  = accountIds_.id(account);
-    for (PluginHost *host : pluginsByPriority_) {
+    bool                      handled = false;
+    const int                 acc_id  = accountIds_.id(account);
+    const QList<PluginHost *> hosts   = eventFilters_;
+    for (PluginHost *host : hosts) {
         if (host->processEvent(acc_id, event)) {
             handled = true;
             break;
@@ -445,9 +473,10 @@ bool PluginManager::processEvent(PsiAccount *account, QDomElement &event)
 bool PluginManager::processOutgoingMessage(PsiAccount *account, const QString &jidTo, QString &body,
                                            const QString &type, QString &subject)
 {
-    bool      handled = false;
-    const int acc_id  = accountIds_.id(account);
-    for (PluginHost *host : pluginByFile_.values()) {
+    bool                      handled = false;
+    const int                 acc_id  = accountIds_.id(account);
+    const QList<PluginHost *> hosts   = eventFilters_;
+    for (PluginHost *host : hosts) {
         if (host->processOutgoingMessage(acc_id, jidTo, body, type, subject)) {
             handled = true;
             break;
@@ -458,8 +487,9 @@ bool PluginManager::processOutgoingMessage(PsiAccount *account, const QString &j
 
 void PluginManager::processOutgoingStanza(PsiAccount *account, QDomElement &stanza)
 {
-    const int acc_id = accountIds_.id(account);
-    for (PluginHost *host : pluginByFile_.values()) {
+    const int                 acc_id = accountIds_.id(account);
+    const QList<PluginHost *> hosts  = outgoingXmlFilters_;
+    for (PluginHost *host : hosts) {
         if (host->outgoingXml(acc_id, stanza)) {
             break;
         }
@@ -524,8 +554,9 @@ QList<OAH_PluginOptionsTab *> PluginManager::settingsPages() const { return sett
  */
 bool PluginManager::incomingXml(int account, const QDomElement &xml)
 {
-    bool handled = false;
-    for (PluginHost *host : pluginsByPriority_) {
+    bool                      handled = false;
+    const QList<PluginHost *> hosts   = incomingXmlFilters_;
+    for (PluginHost *host : hosts) {
         if (host->incomingXml(account, xml)) {
             handled = true;
             break;
@@ -133,6 +133,7 @@ private:
     bool                verifyStanza(const QString &stanza);
     QList<PluginHost *> updatePluginsList();
     void                loadPluginIfEnabled(PluginHost *plugin);
+    void                updateDispatchLists();
 
     static PluginManager *instance_;
 
@@ -148,6 +149,10 @@ private:
     QMap<QString, PluginHost *> pluginByFile_;
     // sorted by priority
     QList<PluginHost *> pluginsByPriority_;
+    // enabled plugins implementing the hooks, sorted by priority. see updateDispatchLists()
+    QList<PluginHost *> incomingXmlFilters_;
+    QList<PluginHost *> outgoingXmlFilters_;
+    QList<PluginHost *> eventFilters_;
 
     QList<QCA::DirWatch *> dirWatchers_;
 
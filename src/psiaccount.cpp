@@ -664,8 +664,6 @@ public:
     }
 
 public slots:
-    void queueChanged() { eventQueue->toFile(pathToProfileEvents()); }
-
     void loadQueue()
     {
         bool soundEnabled = PsiOptions::instance()->getOption("options.ui.notifications.sounds.enable").toBool();
@@ -676,6 +674,7 @@ public slots:
         QFileInfo fi(pathToProfileEvents());
         if (fi.exists())
             eventQueue->fromFile(pathToProfileEvents());
+        eventQueue->setStorage(pathToProfileEvents()); // the changes are journaled from now on
 
         PsiOptions::instance()->setOption("options.ui.notifications.sounds.enable", soundEnabled);
         doPopups_ = true;
@@ -1039,7 +1038,6 @@ PsiAccount::PsiAccount(const UserAccount &acc, PsiContactList *parent, TabManage
 
     d->eventQueue = new EventQueue(this);
     connect(d->eventQueue, SIGNAL(queueChanged()), SIGNAL(queueChanged()));
-    connect(d->eventQueue, SIGNAL(queueChanged()), d, SLOT(queueChanged()));
     connect(d->eventQueue, SIGNAL(eventFromXml(PsiEvent::Ptr)), SLOT(eventFromXml(PsiEvent::Ptr)));
     d->self = UserListItem(true);
     d->self.setSubscription(Subscription::Both);
@@ -1507,11 +1505,13 @@ void PsiAccount::updateClientVersionInfo()
 
 void PsiAccount::deleteQueueFile()
 {
+    d->eventQueue->setStorage(QString());
     QFileInfo fi(d->pathToProfileEvents());
+    QDir      dir = fi.dir();
     if (fi.exists()) {
-        QDir dir = fi.dir();
         dir.remove(fi.fileName());
     }
+    dir.remove(QFileInfo(EventQueue::journalFileName(fi.filePath())).fileName());
 }
 
 const Jid &PsiAccount::jid() const { return d->jid; }
@@ -105,6 +105,7 @@
 #endif
 #ifdef WEBKIT
 #include "avatars.h"
+#include "chatview.h"
 #include "chatviewthemeprovider.h"
 #include "webview.h"
 #endif
@@ -516,6 +517,7 @@ bool PsiCon::init()
         d->iconSelect->setStyleSheet(css);
 
     // first thing, try to load the iconset
+    Iconset::setCachePath(ApplicationInfo::makeSubhomePath("iconsets", ApplicationInfo::CacheLocation));
     bool result = true;
     if (!PsiIconset::instance()->loadAll()) {
         // LEGOPTS.iconset = "stellar";
@@ -562,6 +564,9 @@ bool PsiCon::init()
                               tr("Unable to load theme!  Please make sure Psi is properly installed."));
         result = false;
     }
+#ifdef WEBKIT
+    ChatView::warmUpWebViews();
+#endif
 
     if (!d->actionList)
         d->actionList = new PsiActionList(this);
@@ -746,6 +751,7 @@ void PsiCon::deinit()
     deleteAllDialogs();
 
 #ifdef WEBKIT
+    ChatView::releaseWebViews();
     // unload webkit themes early (before realease of webengine profile)
     delete d->themeManager->unregisterProvider(QString::fromLatin1("groupchatview"));
     delete d->themeManager->unregisterProvider(QString::fromLatin1("chatview"));
@@ -32,9 +32,10 @@
 #include "xmpp_xmlcommon.h"
 
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDomElement>
+#include <QFile>
 #include <QList>
-#include <QSet>
 #include <QTextStream>
 
 using namespace XMLHelper;
@@ -596,6 +597,8 @@ PsiEvent::Ptr EventItem::event() const { return e; }
 // EventQueue
 //----------------------------------------------------------------------------
 
+static const quint32 journalMagic = 0x50534a4c; // the journal header. see EventQueue::compact()
+
 EventQueue::EventQueue(PsiAccount *account) : psi_(nullptr), account_(nullptr), enabled_(false)
 {
     account_ = account;
@@ -613,6 +616,7 @@ EventQueue::~EventQueue()
     setEnabled(false);
     qDeleteAll(list_);
     list_.clear();
+    delete journal_;
 }
 
 bool EventQueue::enabled() const { return enabled_; }
@@ -621,8 +625,14 @@ void EventQueue::setEnabled(bool enabled) { enabled_ = enabled; }
 
 EventQueue &EventQueue::operator=(const EventQueue &from)
 {
-    while (!list_.isEmpty())
-        delete list_.takeFirst();
+    qDeleteAll(list_);
+    list_.clear();
+    entries_.clear();
+    byEvent_.clear();
+    byJid_.clear();
+    byFrom_.clear();
+    firstOfPriority_.clear();
+    journal(JournalClear);
 
     psi_     = from.psi_;
     account_ = from.account_;
@@ -637,30 +647,20 @@ EventQueue &EventQueue::operator=(const EventQueue &from)
 
 int EventQueue::nextId() const
 {
-    if (list_.isEmpty())
+    if (list_.empty())
         return -1;
 
-    EventItem *i = list_.first();
-    if (!i)
-        return -1;
-    return i->id();
+    return list_.front()->id();
 }
 
-int EventQueue::count() const { return list_.count(); }
+int EventQueue::count() const { return int(list_.size()); }
 
-int EventQueue::contactCount() const
-{
-    QSet<QString> set;
-    for (EventItem *i : list_) {
-        set.insert(i->event()->jid().bare());
-    }
-    return set.size();
-}
+int EventQueue::contactCount() const { return byJid_.count(); }
 
 int EventQueue::count(const Jid &j, bool compareRes) const
 {
     int total = 0;
-    for (EventItem *i : list_) {
+    for (EventItem *i : byJid_.value(j.bare())) {
         Jid j2(i->event()->jid());
         if (j.compare(j2, compareRes))
             ++total;
@@ -668,26 +668,67 @@ int EventQueue::count(const Jid &j, bool compareRes) const
     return total;
 }
 
-void EventQueue::enqueue(const PsiEvent::Ptr &e)
+// inserts the item into the queue and its indexes. the queue is ordered by priority, then by arrival
+void EventQueue::insert(EventItem *item)
 {
-    EventItem *i = new EventItem(e);
-
-    int  prior = e->priority();
-    bool found = false;
+    PsiEvent::Ptr e = item->event();
+    Entry         entry;
+    entry.priority = e->priority();
+    entry.jid      = e->jid().bare();
+    entry.from     = e->from().bare();
 
     // skip all with higher or equal priority
-    for (EventItem *ei : list_) {
-        if (ei && ei->event()->priority() < prior) {
-            list_.insert(list_.indexOf(ei), i);
-            found = true;
-            break;
+    auto lower = firstOfPriority_.upper_bound(entry.priority);
+    entry.pos  = list_.insert(lower == firstOfPriority_.end() ? list_.end() : lower->second, item);
+    if (firstOfPriority_.find(entry.priority) == firstOfPriority_.end())
+        firstOfPriority_[entry.priority] = entry.pos;
+
+    // the same for the contact's events
+    for (auto index : { std::make_pair(&byJid_, entry.jid), std::make_pair(&byFrom_, entry.from) }) {
+        QList<EventItem *> &items = (*index.first)[index.second];
+        int                 n     = items.count();
+        while (n > 0 && items[n - 1]->event()->priority() < entry.priority)
+            --n;
+        items.insert(n, item);
+    }
+
+    byEvent_.insert(e.data(), item);
+    entries_.insert(item, entry);
+}
+
+// removes the item from the queue and its indexes. the item itself is left to the caller
+void EventQueue::take(EventItem *item)
+{
+    Entry entry = entries_.take(item);
+
+    auto first = firstOfPriority_.find(entry.priority);
+    if (first != firstOfPriority_.end() && first->second == entry.pos) {
+        auto next = std::next(entry.pos);
+        if (next != list_.end() && (*next)->event()->priority() == entry.priority)
+            first->second = next;
+        else
+            firstOfPriority_.erase(first);
+    }
+    list_.erase(entry.pos);
+
+    for (auto index : { std::make_pair(&byJid_, entry.jid), std::make_pair(&byFrom_, entry.from) }) {
+        auto it = index.first->find(index.second);
+        if (it != index.first->end()) {
+            it->removeOne(item);
+            if (it->isEmpty())
+                index.first->erase(it);
         }
     }
 
-    // everything else
-    if (!found)
-        list_.append(i);
+    byEvent_.remove(item->event().data());
+}
 
+void EventQueue::enqueue(const PsiEvent::Ptr &e)
+{
+    EventItem *i = new EventItem(e);
+    insert(i);
+
+    journal(JournalAdd, i);
     emit queueChanged();
 }
 
@@ -696,23 +737,23 @@ void EventQueue::dequeue(const PsiEvent::Ptr &e)
     if (!e)
         return;
 
-    for (EventItem *i : list_) {
-        if (e == i->event()) {
-            list_.removeAll(i);
-            emit queueChanged();
-            delete i;
-            return;
-        }
+    EventItem *i = byEvent_.value(e.data());
+    if (i) {
+        take(i);
+        journal(JournalRemove, i);
+        emit queueChanged();
+        delete i;
     }
 }
 
 PsiEvent::Ptr EventQueue::dequeue(const Jid &j, bool compareRes)
 {
-    for (EventItem *i : list_) {
+    for (EventItem *i : byJid_.value(j.bare())) {
         PsiEvent::Ptr e = i->event();
         Jid           j2(e->jid());
         if (j.compare(j2, compareRes)) {
-            list_.removeAll(i);
+            take(i);
+            journal(JournalRemove, i);
             emit queueChanged();
             delete i;
             return e;
@@ -724,7 +765,7 @@ PsiEvent::Ptr EventQueue::dequeue(const Jid &j, bool compareRes)
 
 PsiEvent::Ptr EventQueue::peek(const Jid &j, bool compareRes) const
 {
-    for (EventItem *i : list_) {
+    for (EventItem *i : byJid_.value(j.bare())) {
         PsiEvent::Ptr e = i->event();
         Jid           j2(e->jid());
         if (j.compare(j2, compareRes)) {
@@ -737,14 +778,13 @@ PsiEvent::Ptr EventQueue::peek(const Jid &j, bool compareRes) const
 
 PsiEvent::Ptr EventQueue::dequeueNext()
 {
-    if (list_.isEmpty())
+    if (list_.empty())
         return PsiEvent::Ptr();
 
-    EventItem *i = list_.first();
-    if (!i)
-        return PsiEvent::Ptr();
+    EventItem *   i = list_.front();
     PsiEvent::Ptr e = i->event();
-    list_.removeAll(i);
+    take(i);
+    journal(JournalRemove, i);
     emit queueChanged();
     delete i;
     return e;
@@ -752,18 +792,15 @@ PsiEvent::Ptr EventQueue::dequeueNext()
 
 PsiEvent::Ptr EventQueue::peekNext() const
 {
-    if (list_.isEmpty())
+    if (list_.empty())
         return PsiEvent::Ptr();
 
-    EventItem *i = list_.first();
-    if (!i)
-        return PsiEvent::Ptr();
-    return i->event();
+    return list_.front()->event();
 }
 
 PsiEvent::Ptr EventQueue::peekFirstChat(const Jid &j, bool compareRes) const
 {
-    for (EventItem *i : list_) {
+    for (EventItem *i : byFrom_.value(j.bare())) {
         PsiEvent::Ptr e = i->event();
         if (e->type() == PsiEvent::Message) {
             MessageEvent::Ptr me = e.staticCast<MessageEvent>();
@@ -782,8 +819,10 @@ void EventQueue::extractChats(QList<PsiEvent::Ptr> *el, const Jid &j, bool compa
 {
     bool changed = false;
 
-    for (QList<EventItem *>::Iterator it = list_.begin(); it != list_.end();) {
-        PsiEvent::Ptr e       = (*it)->event();
+    // a copy, as the index is changed when the events are removed
+    const QList<EventItem *> items = byFrom_.value(j.bare());
+    for (EventItem *ei : items) {
+        PsiEvent::Ptr e       = ei->event();
         bool          extract = false;
         if (e->type() == PsiEvent::Message) {
             MessageEvent::Ptr me = e.staticCast<MessageEvent>();
@@ -798,14 +837,11 @@ void EventQueue::extractChats(QList<PsiEvent::Ptr> *el, const Jid &j, bool compa
         }
 
         if (extract && removeEvents) {
-            EventItem *ei = *it;
-            it            = list_.erase(it);
+            take(ei);
+            journal(JournalRemove, ei);
             delete ei;
             changed = true;
-            continue;
         }
-
-        ++it;
     }
 
     if (changed)
@@ -814,11 +850,9 @@ void EventQueue::extractChats(QList<PsiEvent::Ptr> *el, const Jid &j, bool compa
 
 void EventQueue::extractByJid(QList<PsiEvent::Ptr> *list, const XMPP::Jid &jid)
 {
-    for (QList<EventItem *>::Iterator it = list_.begin(); it != list_.end(); it++) {
-        PsiEvent::Ptr e = (*it)->event();
-        if (jid.compare(e->from(), false)) {
-            list->append(e);
-        }
+    // all the events indexed under the bare jid are the same ignoring the resource
+    for (EventItem *i : byFrom_.value(jid.bare())) {
+        list->append(i->event());
     }
 }
 
@@ -830,17 +864,16 @@ void EventQueue::extractByType(int type, QList<PsiEvent::Ptr> *el)
 {
     bool changed = false;
 
-    for (QList<EventItem *>::Iterator it = list_.begin(); it != list_.end();) {
-        PsiEvent::Ptr e = (*it)->event();
+    for (auto it = list_.begin(); it != list_.end();) {
+        EventItem *   ei = *it++; // take() invalidates the current position only
+        PsiEvent::Ptr e  = ei->event();
         if (e->type() == type) {
             el->append(e);
-            EventItem *ei = *it;
-            it            = list_.erase(it);
+            take(ei);
+            journal(JournalRemove, ei);
             delete ei;
             changed = true;
-            continue;
         }
-        ++it;
     }
 
     if (changed)
@@ -858,10 +891,14 @@ void EventQueue::printContent() const
 
 void EventQueue::clear()
 {
-    while (!list_.isEmpty()) {
-        EventItem *i = list_.takeFirst();
-        delete i;
-    }
+    qDeleteAll(list_);
+    list_.clear();
+    entries_.clear();
+    byEvent_.clear();
+    byJid_.clear();
+    byFrom_.clear();
+    firstOfPriority_.clear();
+    journal(JournalClear);
 
     emit queueChanged();
 }
@@ -871,16 +908,15 @@ void EventQueue::clear(const Jid &j, bool compareRes)
 {
     bool changed = false;
 
-    for (QList<EventItem *>::Iterator it = list_.begin(); it != list_.end();) {
-        PsiEvent::Ptr e = (*it)->event();
-        Jid           j2(e->jid());
+    const QList<EventItem *> items = byJid_.value(j.bare());
+    for (EventItem *ei : items) {
+        Jid j2(ei->event()->jid());
         if (j.compare(j2, compareRes)) {
-            EventItem *ei = *it;
-            it            = list_.erase(it);
+            take(ei);
+            journal(JournalRemove, ei);
             delete ei;
             changed = true;
-        } else
-            ++it;
+        }
     }
 
     if (changed)
@@ -891,10 +927,13 @@ QDomElement EventQueue::toXml(QDomDocument *doc) const
 {
     QDomElement e = doc->createElement("eventQueue");
     e.setAttribute("version", "1.0");
+    if (journalEpoch_)
+        e.setAttribute("journal-epoch", QString::number(journalEpoch_)); // see compact()
     e.appendChild(textTag(doc, "progver", ApplicationInfo::version()));
 
     for (EventItem *i : list_) {
         QDomElement event = i->event()->toXml(doc);
+        event.setAttribute("queue-id", i->id()); // referred to by the journal
         e.appendChild(event);
     }
 
@@ -949,7 +988,7 @@ QList<EventQueue::PsiEventId> EventQueue::eventsFor(const XMPP::Jid &jid, bool c
 {
     QList<PsiEventId> result;
 
-    for (EventItem *i : list_) {
+    for (EventItem *i : byFrom_.value(jid.bare())) {
         if (i->event()->from().compare(jid, compareRes))
             result << QPair<int, PsiEvent::Ptr>(i->id(), i->event());
     }
@@ -975,7 +1014,111 @@ bool EventQueue::fromFile(const QString &fname)
         return false;
 
     QDomElement base = doc.documentElement();
+
+    // replay the changes made after the snapshot was written. the journal left from an older
+    // snapshot refers to the ids of another session, so it's ignored
+    QFile journalFile(journalFileName(fname));
+    if (journalFile.open(QIODevice::ReadOnly)) {
+        QHash<int, QDomElement> events;
+        for (QDomElement e = base.firstChildElement("event"); !e.isNull(); e = e.nextSiblingElement("event"))
+            events.insert(e.attribute("queue-id").toInt(), e);
+
+        QDataStream in(&journalFile);
+        quint32     magic;
+        quint64     epoch;
+        in >> magic >> epoch;
+        const bool valid = in.status() == QDataStream::Ok && magic == journalMagic && epoch
+            && epoch == base.attribute("journal-epoch").toULongLong();
+        while (valid && !in.atEnd()) {
+            quint8     op;
+            qint32     id;
+            QByteArray xml;
+            in >> op >> id >> xml;
+            if (in.status() != QDataStream::Ok)
+                break; // the last record may be cut short by a crash
+
+            if (op == JournalAdd) {
+                QDomDocument eventDoc;
+                if (!events.contains(id) && eventDoc.setContent(xml)) {
+                    QDomElement e = doc.importNode(eventDoc.documentElement(), true).toElement();
+                    base.appendChild(e);
+                    events.insert(id, e);
+                }
+            } else if (op == JournalRemove) {
+                base.removeChild(events.take(id));
+            } else if (op == JournalClear) {
+                for (const QDomElement &e : events)
+                    base.removeChild(e);
+                events.clear();
+            }
+        }
+    }
+
     return fromXml(&base);
 }
 
+/**
+ * From now on the queue is saved to \a fname. It's written once, and then only the changes
+ * are appended to the journal next to it, until the journal gets larger than the queue itself.
+ * fromFile() replays the journal. An empty \a fname stops saving.
+ */
+void EventQueue::setStorage(const QString &fname)
+{
+    delete journal_;
+    journal_        = nullptr;
+    journalRecords_ = 0;
+    storage_        = fname;
+    if (!storage_.isEmpty())
+        compact();
+}
+
+QString EventQueue::journalFileName(const QString &fname) { return fname + ".journal"; }
+
+void EventQueue::journal(JournalOp op, const EventItem *item)
+{
+    if (!journal_)
+        return;
+
+    // the snapshot is rewritten once as many changes as there are events are collected,
+    // so a change costs O(1) disk writes on average
+    if (++journalRecords_ > qMax(64, 2 * count())) {
+        compact();
+        return;
+    }
+
+    QByteArray xml;
+    if (op == JournalAdd) {
+        QDomDocument doc;
+        doc.appendChild(item->event()->toXml(&doc));
+        xml = doc.toByteArray(-1);
+    }
+
+    QDataStream out(journal_);
+    out << quint8(op) << qint32(item ? item->id() : -1) << xml;
+    journal_->flush();
+}
+
+void EventQueue::compact()
+{
+    if (!journal_)
+        journal_ = new QFile(journalFileName(storage_));
+    journal_->close();
+    journalRecords_ = 0;
+
+    // the snapshot goes first, with a new epoch. if the old journal isn't truncated after that,
+    // fromFile() ignores it, as its epoch doesn't match anymore
+    journalEpoch_ = qMax(quint64(QDateTime::currentMSecsSinceEpoch()), journalEpoch_ + 1);
+    toFile(storage_);
+    if (!journal_->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("EventQueue: can't write %s", qPrintable(journal_->fileName()));
+        delete journal_;
+        journal_ = nullptr;
+        return;
+    }
+
+    QDataStream out(journal_);
+    out << journalMagic << journalEpoch_;
+    journal_->flush();
+}
+
 #include "psievent.moc"
@@ -28,14 +28,19 @@
 #include <QDateTime>
 #include <QDomDocument>
 #include <QDomElement>
+#include <QHash>
 #include <QList>
 #include <QObject>
 #include <QPointer>
+#include <functional>
+#include <list>
+#include <map>
 
 class AvCall;
 class PsiAccount;
 class PsiCon;
 class QDomElement;
+class QFile;
 
 namespace XMPP {
 class FileTransfer;
@@ -391,15 +396,45 @@ public:
     bool toFile(const QString &fname);
     bool fromFile(const QString &fname);
 
+    void           setStorage(const QString &fname);
+    static QString journalFileName(const QString &fname);
+
 signals:
     void eventFromXml(const PsiEvent::Ptr &);
     void queueChanged();
 
 private:
-    QList<EventItem *> list_;
-    PsiCon *           psi_;
-    PsiAccount *       account_;
-    bool               enabled_;
+    enum JournalOp : quint8 { JournalAdd, JournalRemove, JournalClear };
+
+    typedef std::list<EventItem *> ItemList;
+
+    // where an item is queued and what it's indexed by
+    struct Entry {
+        ItemList::iterator pos;
+        QString            jid;  // bare
+        QString            from; // bare
+        int                priority = 0;
+    };
+
+    void insert(EventItem *item);
+    void take(EventItem *item);
+    void journal(JournalOp op, const EventItem *item = nullptr);
+    void compact();
+
+    ItemList                           list_; // by priority, then by arrival
+    QHash<EventItem *, Entry>          entries_;
+    QHash<PsiEvent *, EventItem *>     byEvent_;
+    QHash<QString, QList<EventItem *>> byJid_;  // bare jid => items in queue order
+    QHash<QString, QList<EventItem *>> byFrom_; // the same, for the senders
+    std::map<int, ItemList::iterator, std::greater<int>> firstOfPriority_; // the first item of every priority
+
+    PsiCon *    psi_;
+    PsiAccount *account_;
+    bool        enabled_;
+    QString     storage_; // see setStorage()
+    QFile *     journal_        = nullptr;
+    int         journalRecords_ = 0;
+    quint64     journalEpoch_   = 0; // written with the snapshot and the journal, so they can be matched
 };
 
 #endif // PSIEVENT_H
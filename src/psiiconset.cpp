@@ -22,15 +22,19 @@
 #include "anim.h"
 #include "applicationinfo.h"
 #include "common.h"
+#include "emoticonmatcher.h"
 #include "psievent.h"
 #include "psioptions.h"
 #include "userlist.h"
 
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QFuture>
 #include <QSet>
 #include <QStandardPaths>
 #include <QTextStream>
+#include <QThread>
+#include <QtConcurrentRun>
 
 using namespace XMPP;
 
@@ -95,6 +99,7 @@ public:
     ClientIconMap          client2icon;
     QString                cur_system, cur_status, cur_moods, cur_clients, cur_activity, cur_affiliations;
     QStringList            cur_emoticons;
+    EmoticonMatcher        emoticonMatcher; // compiled texts of PsiIconset::emoticons
     QMap<QString, QString> cur_service_status;
     QMap<QString, QString> cur_custom_status;
     struct StatusIconsets {
@@ -214,14 +219,14 @@ public:
         return icon;
     }
 
-    Iconset systemIconset(bool *ok)
+    Iconset systemIconset(const QString &name, bool *ok)
     {
         Iconset def;
         *ok = def.load(":/iconsets/system/default");
 
-        if (PsiOptions::instance()->getOption("options.iconsets.system").toString() != "default") {
+        if (name != "default") {
             Iconset is;
-            is.load(iconsetPath("system/" + PsiOptions::instance()->getOption("options.iconsets.system").toString()));
+            is.load(iconsetPath("system/" + name));
 
             loadIconset(&def, &is);
         }
@@ -231,31 +236,31 @@ public:
         return def;
     }
 
-    Iconset *defaultRosterIconset(bool *ok)
+    Iconset defaultRosterIconset(const QString &name, bool *ok)
     {
-        Iconset *def = new Iconset;
-        *ok          = def->load(":/iconsets/roster/default");
+        Iconset def;
+        *ok = def.load(":/iconsets/roster/default");
 
-        if (PsiOptions::instance()->getOption("options.iconsets.status").toString() != "default") {
+        if (name != "default") {
             Iconset is;
-            is.load(iconsetPath("roster/" + PsiOptions::instance()->getOption("options.iconsets.status").toString()));
+            is.load(iconsetPath("roster/" + name));
 
-            loadIconset(def, &is);
+            loadIconset(&def, &is);
         }
 
-        stripFirstAnimFrame(*def);
+        stripFirstAnimFrame(def);
 
         return def;
     }
 
-    Iconset moodsIconset(bool *ok)
+    Iconset moodsIconset(const QString &name, bool *ok)
     {
         Iconset def;
         *ok = def.load(iconsetPath("moods/default"));
 
-        if (PsiOptions::instance()->getOption("options.iconsets.moods").toString() != "default") {
+        if (name != "default") {
             Iconset is;
-            is.load(iconsetPath("moods/" + PsiOptions::instance()->getOption("options.iconsets.moods").toString()));
+            is.load(iconsetPath("moods/" + name));
 
             loadIconset(&def, &is);
         }
@@ -265,15 +270,14 @@ public:
         return def;
     }
 
-    Iconset activityIconset(bool *ok)
+    Iconset activityIconset(const QString &name, bool *ok)
     {
         Iconset def;
         *ok = def.load(iconsetPath("activities/default"));
 
-        if (PsiOptions::instance()->getOption("options.iconsets.activities").toString() != "default") {
+        if (name != "default") {
             Iconset is;
-            is.load(iconsetPath("activities/"
-                                + PsiOptions::instance()->getOption("options.iconsets.activities").toString()));
+            is.load(iconsetPath("activities/" + name));
 
             loadIconset(&def, &is);
         }
@@ -283,14 +287,14 @@ public:
         return def;
     }
 
-    Iconset clientsIconset(bool *ok)
+    Iconset clientsIconset(const QString &name, bool *ok)
     {
         Iconset def;
         *ok = def.load(iconsetPath("clients/default"));
 
-        if (PsiOptions::instance()->getOption("options.iconsets.clients").toString() != "default") {
+        if (name != "default") {
             Iconset is;
-            is.load(iconsetPath("clients/" + PsiOptions::instance()->getOption("options.iconsets.clients").toString()));
+            is.load(iconsetPath("clients/" + name));
 
             loadIconset(&def, &is);
         }
@@ -300,15 +304,14 @@ public:
         return def;
     }
 
-    Iconset affiliationsIconset(bool *ok)
+    Iconset affiliationsIconset(const QString &name, bool *ok)
     {
         Iconset def;
         *ok = def.load(iconsetPath("affiliations/default"));
 
-        if (PsiOptions::instance()->getOption("options.iconsets.affiliations").toString() != "default") {
+        if (name != "default") {
             Iconset is;
-            is.load(iconsetPath("affiliations/"
-                                + PsiOptions::instance()->getOption("options.iconsets.affiliations").toString()));
+            is.load(iconsetPath("affiliations/" + name));
 
             loadIconset(&def, &is);
         }
@@ -318,30 +321,127 @@ public:
         return def;
     }
 
-    QList<Iconset *> emoticons()
+    Iconset emoticonIconset(const QString &name, bool *ok)
+    {
+        Iconset is;
+        *ok = is.load(iconsetPath("emoticons/" + name));
+        if (!*ok) {
+            is  = Iconset();
+            *ok = is.load(iconsetPath(name, Iconset::Format::KdeEmoticons), Iconset::Format::KdeEmoticons);
+        }
+        return is;
+    }
+
+    QList<Iconset *> emoticons(const QStringList &names)
     {
         QList<Iconset *> emo;
 
-        const auto names = PsiOptions::instance()->getOption("options.iconsets.emoticons").toStringList();
         for (const QString &name : names) {
-            Iconset *is = new Iconset;
-            if (is->load(iconsetPath("emoticons/" + name))) {
+            Loaded loaded = take("emoticons", name);
+            if (loaded.ok) {
                 // PsiIconset::removeAnimation(is);
+                Iconset *is = new Iconset(loaded.iconset);
                 is->addToFactory();
                 emo.append(is);
-                continue;
             }
-            delete is;
-            is = new Iconset;
-            if (is->load(iconsetPath(name, Iconset::Format::KdeEmoticons), Iconset::Format::KdeEmoticons)) {
-                is->addToFactory();
-                emo.append(is);
-            } else
-                delete is;
         }
 
         return emo;
     }
+
+    // roster iconsets chosen for transports and custom statuses. fills cur_service_status and cur_custom_status
+    QSet<QString> readRosterIconsetOptions()
+    {
+        QSet<QString> rosterIconsets;
+        cur_service_status.clear();
+        cur_custom_status.clear();
+
+        for (QVariant service : PsiOptions::instance()->mapKeyList("options.iconsets.service-status")) {
+            QString val = PsiOptions::instance()
+                              ->getOption(PsiOptions::instance()->mapLookup("options.iconsets.service-status", service)
+                                          + ".iconset")
+                              .toString();
+            if (val.isEmpty())
+                continue;
+            rosterIconsets << val;
+            cur_service_status.insert(service.toString(), val);
+        }
+
+        QStringList customicons
+            = PsiOptions::instance()->getChildOptionNames("options.iconsets.custom-status", true, true);
+        for (const QString &base : customicons) {
+            QString regexp  = PsiOptions::instance()->getOption(base + ".regexp").toString();
+            QString iconset = PsiOptions::instance()->getOption(base + ".iconset").toString();
+            rosterIconsets << iconset;
+            cur_custom_status.insert(regexp, iconset);
+        }
+
+        return rosterIconsets;
+    }
+
+    struct Loaded {
+        Iconset iconset;
+        bool    ok = false;
+    };
+    QHash<QString, QFuture<Loaded>> preloaded; // kind + '/' + name -> the iconset being loaded by a worker thread
+
+    /**
+     * Parses and decodes the iconset \a name of \a kind (the directory in iconsets/).
+     * Doesn't touch options or IconsetFactory, so it may run in a worker thread.
+     */
+    Loaded load(const QString &kind, const QString &name)
+    {
+        Loaded ret;
+        if (kind == "system") {
+            ret.iconset = systemIconset(name, &ret.ok);
+        } else if (kind == "status") {
+            ret.iconset = defaultRosterIconset(name, &ret.ok);
+        } else if (kind == "roster") {
+            ret.ok = ret.iconset.load(iconsetPath("roster/" + name));
+            if (ret.ok) {
+                stripFirstAnimFrame(ret.iconset);
+            }
+        } else if (kind == "emoticons") {
+            ret.iconset = emoticonIconset(name, &ret.ok);
+        } else if (kind == "moods") {
+            ret.iconset = moodsIconset(name, &ret.ok);
+        } else if (kind == "activities") {
+            ret.iconset = activityIconset(name, &ret.ok);
+        } else if (kind == "clients") {
+            ret.iconset = clientsIconset(name, &ret.ok);
+        } else if (kind == "affiliations") {
+            ret.iconset = affiliationsIconset(name, &ret.ok);
+        }
+        return ret;
+    }
+
+    void preload(const QString &kind, const QString &name)
+    {
+        const QString key = kind + '/' + name;
+        if (!preloaded.contains(key)) {
+            preloaded.insert(key, QtConcurrent::run([this, kind, name]() { return load(kind, name); }));
+        }
+    }
+
+    // returns the iconset loaded in advance by preload() or loads it right now
+    Loaded take(const QString &kind, const QString &name)
+    {
+        auto it = preloaded.find(kind + '/' + name);
+        if (it == preloaded.end()) {
+            return load(kind, name);
+        }
+        Loaded ret = it->result();
+        preloaded.erase(it);
+        return ret;
+    }
+
+    void dropPreloaded()
+    {
+        for (auto &f : preloaded) {
+            f.waitForFinished();
+        }
+        preloaded.clear();
+    }
 };
 
 PsiIconset::PsiIconset() : QObject(QCoreApplication::instance())
@@ -367,7 +467,9 @@ bool PsiIconset::loadSystem()
     bool    ok         = true;
     QString cur_system = PsiOptions::instance()->getOption("options.iconsets.system").toString();
     if (d->cur_system != cur_system) {
-        Iconset sys = d->systemIconset(&ok);
+        auto    loaded = d->take("system", cur_system);
+        Iconset sys    = loaded.iconset;
+        ok             = loaded.ok;
 
         if (sys.iconSize() != d->system.iconSize()) {
             emit systemIconsSizeChanged(sys.iconSize());
@@ -391,49 +493,27 @@ bool PsiIconset::loadRoster()
     roster.clear();
 
     // default roster iconset
-    bool     ok;
-    Iconset *def = d->defaultRosterIconset(&ok);
+    QString  cur_status = PsiOptions::instance()->getOption("options.iconsets.status").toString();
+    auto     loaded     = d->take("status", cur_status);
+    bool     ok         = loaded.ok;
+    Iconset *def        = new Iconset(loaded.iconset);
     def->addToFactory();
-    roster.insert(PsiOptions::instance()->getOption("options.iconsets.status").toString(), def);
+    roster.insert(cur_status, def);
 
-    d->cur_status = PsiOptions::instance()->getOption("options.iconsets.status").toString();
+    d->cur_status = cur_status;
 
     // load only necessary roster iconsets
-    QSet<QString> rosterIconsets;
-    d->cur_service_status.clear();
-
-    for (QVariant service : PsiOptions::instance()->mapKeyList("options.iconsets.service-status")) {
-        QString val = PsiOptions::instance()
-                          ->getOption(PsiOptions::instance()->mapLookup("options.iconsets.service-status", service)
-                                      + ".iconset")
-                          .toString();
-        if (val.isEmpty())
-            continue;
-        rosterIconsets << val;
-        d->cur_service_status.insert(service.toString(), val);
-    }
-
-    QStringList customicons = PsiOptions::instance()->getChildOptionNames("options.iconsets.custom-status", true, true);
-    d->cur_custom_status.clear();
-    for (const QString &base : customicons) {
-        QString regexp  = PsiOptions::instance()->getOption(base + ".regexp").toString();
-        QString iconset = PsiOptions::instance()->getOption(base + ".iconset").toString();
-        rosterIconsets << iconset;
-        d->cur_custom_status.insert(regexp, iconset);
-    }
-
+    const QSet<QString> rosterIconsets = d->readRosterIconsetOptions();
     for (const QString &it2 : rosterIconsets) {
-        if (it2 == PsiOptions::instance()->getOption("options.iconsets.status").toString()) {
+        if (it2 == cur_status) {
             continue;
         }
 
-        Iconset *is = new Iconset;
-        if (is->load(d->iconsetPath("roster/" + it2))) {
+        loaded = d->take("roster", it2);
+        if (loaded.ok) {
+            Iconset *is = new Iconset(loaded.iconset);
             is->addToFactory();
-            d->stripFirstAnimFrame(*is);
             roster.insert(it2, is);
-        } else {
-            delete is;
         }
     }
 
@@ -446,7 +526,8 @@ void PsiIconset::loadEmoticons()
     if (d->cur_emoticons != cur_emoticons) {
         qDeleteAll(emoticons);
         emoticons.clear();
-        emoticons = d->emoticons();
+        emoticons = d->emoticons(cur_emoticons);
+        d->emoticonMatcher.build(emoticons);
 
         d->cur_emoticons = cur_emoticons;
         emit emoticonsChanged();
@@ -458,7 +539,9 @@ bool PsiIconset::loadMoods()
     bool    ok        = true;
     QString cur_moods = PsiOptions::instance()->getOption("options.iconsets.moods").toString();
     if (d->cur_moods != cur_moods) {
-        Iconset moods = d->moodsIconset(&ok);
+        auto    loaded = d->take("moods", cur_moods);
+        Iconset moods  = loaded.iconset;
+        ok             = loaded.ok;
         d->loadIconset(&d->moods, &moods);
         d->moods.addToFactory();
 
@@ -473,7 +556,9 @@ bool PsiIconset::loadActivity()
     bool    ok           = true;
     QString cur_activity = PsiOptions::instance()->getOption("options.iconsets.activities").toString();
     if (d->cur_activity != cur_activity) {
-        Iconset activities = d->activityIconset(&ok);
+        auto    loaded     = d->take("activities", cur_activity);
+        Iconset activities = loaded.iconset;
+        ok                 = loaded.ok;
         d->loadIconset(&d->activities, &activities);
         d->activities.addToFactory();
 
@@ -488,7 +573,9 @@ bool PsiIconset::loadClients()
     bool    ok          = true;
     QString cur_clients = PsiOptions::instance()->getOption("options.iconsets.clients").toString();
     if (d->cur_clients != cur_clients) {
-        Iconset clients = d->clientsIconset(&ok);
+        auto    loaded  = d->take("clients", cur_clients);
+        Iconset clients = loaded.iconset;
+        ok              = loaded.ok;
         d->loadIconset(&d->clients, &clients);
         d->clients.addToFactory();
 
@@ -576,7 +663,9 @@ bool PsiIconset::loadAffiliations()
     bool    ok               = true;
     QString cur_affiliations = PsiOptions::instance()->getOption("options.iconsets.affiliations").toString();
     if (d->cur_affiliations != cur_affiliations) {
-        Iconset affiliations = d->affiliationsIconset(&ok);
+        auto    loaded       = d->take("affiliations", cur_affiliations);
+        Iconset affiliations = loaded.iconset;
+        ok                   = loaded.ok;
         d->loadIconset(&d->affiliations, &affiliations);
         d->affiliations.addToFactory();
 
@@ -658,8 +747,42 @@ void PsiIconset::loadStatusIconDefinitions()
 
 bool PsiIconset::loadAll()
 {
-    if (!loadSystem() || !loadRoster())
+    // the icons made in the worker threads have to live in this one
+    if (!Anim::mainThread()) {
+        Anim::setMainThread(QThread::currentThread());
+    }
+
+    // parse and decode all the iconsets in parallel. the load*() functions below
+    // take them in the usual order, so the factory gets them in the same order as before
+    auto o       = PsiOptions::instance();
+    auto preload = [this, o](const QString &kind, const QString &option, const QString &current) {
+        QString name = o->getOption(option).toString();
+        if (name != current) { // otherwise it's already loaded
+            d->preload(kind, name);
+        }
+    };
+    preload("system", "options.iconsets.system", d->cur_system);
+    preload("status", "options.iconsets.status", QString());
+    for (const QString &name : d->readRosterIconsetOptions()) {
+        if (name != o->getOption("options.iconsets.status").toString()) {
+            d->preload("roster", name);
+        }
+    }
+    const QStringList emoticonIconsets = o->getOption("options.iconsets.emoticons").toStringList();
+    if (emoticonIconsets != d->cur_emoticons) {
+        for (const QString &name : emoticonIconsets) {
+            d->preload("emoticons", name);
+        }
+    }
+    preload("moods", "options.iconsets.moods", d->cur_moods);
+    preload("activities", "options.iconsets.activities", d->cur_activity);
+    preload("clients", "options.iconsets.clients", d->cur_clients);
+    preload("affiliations", "options.iconsets.affiliations", d->cur_affiliations);
+
+    if (!loadSystem() || !loadRoster()) {
+        d->dropPreloaded();
         return false;
+    }
 
     loadEmoticons();
     loadMoods();
@@ -667,6 +790,7 @@ bool PsiIconset::loadAll()
     loadClients();
     loadAffiliations();
     loadStatusIconDefinitions();
+    d->dropPreloaded(); // in case some of them were not taken
     return true;
 }
 
@@ -707,7 +831,7 @@ void PsiIconset::reloadRoster()
     QString cur_status = PsiOptions::instance()->getOption("options.iconsets.status").toString();
     // default roster iconset
     if (d->cur_status != cur_status) {
-        Iconset *newDef = d->defaultRosterIconset(&ok);
+        Iconset *newDef = new Iconset(d->defaultRosterIconset(cur_status, &ok));
         Iconset *oldDef = roster[d->cur_status];
 
         if (oldDef->iconSize() != newDef->iconSize())
@@ -984,6 +1108,11 @@ PsiIcon PsiIconset::status(UserListItem *u)
 
 const Iconset &PsiIconset::system() const { return d->system; }
 
+/**
+ * Matcher for the texts of the currently loaded emoticons. Rebuilt each time they are reloaded.
+ */
+const EmoticonMatcher &PsiIconset::emoticonMatcher() const { return d->emoticonMatcher; }
+
 void PsiIconset::stripFirstAnimFrame(Iconset *is)
 {
     if (is)
@@ -25,6 +25,7 @@
 
 #include <QMap>
 
+class EmoticonMatcher;
 class UserListItem;
 
 namespace XMPP {
@@ -48,6 +49,7 @@ public:
     Iconset                   clients;
     Iconset                   affiliations;
     const Iconset &           system() const;
+    const EmoticonMatcher &   emoticonMatcher() const;
     void                      stripFirstAnimFrame(Iconset *);
     static void               removeAnimation(Iconset *);
 
@@ -110,6 +110,7 @@ list(APPEND HEADERS
     chatviewcommon.h
     coloropt.h
     common.h
+    completionindex.h
     conferencebookmark.h
     contactlistaccountmenu.h
     contactlistdragmodel.h
@@ -132,6 +133,7 @@ list(APPEND HEADERS
     dummystream.h
     edbflatfile.h
     edbsqlite.h
+    emoticonmatcher.h
     eventdb.h
     eventdlg.h
     filecache.h
@@ -168,6 +170,7 @@ list(APPEND HEADERS
     mainwin_p.h
     mcmdcompletion.h
     mcmdmanager.h
+    messageformatter.h
     messageview.h
     miniclient.h
     minicmd.h
@@ -360,6 +363,7 @@ list(APPEND SOURCES
     chatviewcommon.cpp
     coloropt.cpp
     common.cpp
+    completionindex.cpp
     conferencebookmark.cpp
     contactlistaccountmenu.cpp
     contactlistdragmodel.cpp
@@ -379,6 +383,7 @@ list(APPEND SOURCES
     dummystream.cpp
     edbflatfile.cpp
     edbsqlite.cpp
+    emoticonmatcher.cpp
     eventdb.cpp
     eventdlg.cpp
     filecache.cpp
@@ -416,6 +421,7 @@ list(APPEND SOURCES
     mcmdcompletion.cpp
     mcmdmanager.cpp
     mcmdsimplesite.cpp
+    messageformatter.cpp
     messageview.cpp
     miniclient.cpp
     mood.cpp
@@ -108,6 +108,7 @@ HEADERS += \
     $$PWD/desktoputil.h \
     $$PWD/fileutil.h \
     $$PWD/textutil.h \
+    $$PWD/emoticonmatcher.h \
     $$PWD/pixmaputil.h \
     $$PWD/psiaccount.h \
     $$PWD/psicon.h \
@@ -142,6 +143,7 @@ HEADERS += \
     $$PWD/chatviewcommon.h \
     $$PWD/chatview.h \
     $$PWD/messageview.h \
+    $$PWD/messageformatter.h \
     $$PWD/statusdlg.h \
     $$PWD/statuscombobox.h \
     $$PWD/eventdlg.h \
@@ -230,6 +232,7 @@ HEADERS += \
     $$PWD/rosteravatarframe.h \
     $$PWD/psicapsregsitry.h \
     $$PWD/tabcompletion.h \
+    $$PWD/completionindex.h \
     $$PWD/alertmanager.h \
     $$PWD/mcmdcompletion.h \
     $$PWD/captchadlg.h \
@@ -257,6 +260,7 @@ SOURCES += \
     $$PWD/desktoputil.cpp \
     $$PWD/fileutil.cpp \
     $$PWD/textutil.cpp \
+    $$PWD/emoticonmatcher.cpp \
     $$PWD/pixmaputil.cpp \
     $$PWD/accountscombobox.cpp \
     $$PWD/psievent.cpp \
@@ -288,6 +292,7 @@ SOURCES += \
     $$PWD/msgmle.cpp \
     $$PWD/chatviewcommon.cpp \
     $$PWD/messageview.cpp \
+    $$PWD/messageformatter.cpp \
     $$PWD/statusdlg.cpp \
     $$PWD/statuscombobox.cpp \
     $$PWD/eventdlg.cpp \
@@ -372,6 +377,7 @@ SOURCES += \
     $$PWD/geolocationdlg.cpp \
     $$PWD/rosteravatarframe.cpp \
     $$PWD/tabcompletion.cpp \
+    $$PWD/completionindex.cpp \
     $$PWD/psicapsregsitry.cpp \
     $$PWD/alertmanager.cpp \
     $$PWD/mcmdcompletion.cpp \
@@ -31,7 +31,7 @@ QSize SvgIconEngine::actualSize(const QSize &size, QIcon::Mode mode, QIcon::Stat
     return size.isEmpty() ? renderer->defaultSize() : renderer->defaultSize().scaled(size, Qt::KeepAspectRatio);
 }
 
-QIconEngine *SvgIconEngine::clone() const { return new SvgIconEngine(name, renderer); }
+QIconEngine *SvgIconEngine::clone() const { return new SvgIconEngine(name, renderer, cacheKey); }
 
 void SvgIconEngine::paint(QPainter *painter, const QRect &rect, QIcon::Mode mode, QIcon::State state)
 {
@@ -67,41 +67,22 @@ void SvgIconEngine::virtual_hook(int id, void *data)
 
 QPixmap SvgIconEngine::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
 {
-    QPixmap     pm;
-    static auto findCache = [](std::list<CacheEntry> &cache, const QSize &size, QPixmap &pm) mutable {
-        auto it = cache.begin();
-        while (it != cache.end()) {
-            if (it->size == size) {
-                if (QPixmapCache::find(it->key, &pm)) {
-                    return true;
-                }
-                cache.erase(it);
-                return false;
-            }
-            ++it;
-        }
-        return false;
-    };
-
-    static auto insertCache = [](std::list<CacheEntry> &cache, const QSize &size, const QPixmap &pm) mutable {
-        cache.push_back(CacheEntry { QPixmapCache::insert(pm), size });
-        if (cache.size() > 5) {
-            QPixmapCache::remove(cache.front().key);
-        }
-    };
+    if (mode == QIcon::Active) {
+        mode = QIcon::Normal;
+    }
+    // the size already includes the device pixel ratio (see ScaledPixmapHook)
+    const QString key = QString("%1/%2x%3/%4").arg(cacheKey).arg(size.width()).arg(size.height()).arg(int(mode));
 
-    if (mode == QIcon::Disabled && findCache(disabledCache, size, pm))
+    QPixmap pm;
+    if (QPixmapCache::find(key, &pm)) {
         return pm;
-
-    if (findCache(normalCache, size, pm)) {
-        if (mode == QIcon::Active || mode == QIcon::Normal)
-            return pm;
     }
 
-    if (!pm) {
+    if (mode == QIcon::Normal) {
         pm = renderPixmap(size, mode, state);
-        insertCache(normalCache, size, pm);
-    } // else we need selected or disabled from normal which we took from the cache
+    } else {
+        pm = pixmap(size, QIcon::Normal, state); // selected and disabled are made of normal
+    }
 
     if (mode == QIcon::Selected) {
         auto hlColor = qApp->palette().color(QPalette::Normal, QPalette::Highlight);
@@ -130,9 +111,9 @@ QPixmap SvgIconEngine::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State
             }
         }
         pm = QPixmap::fromImage(img);
-        insertCache(disabledCache, size, pm);
     }
 
+    QPixmapCache::insert(key, pm);
     return pm;
 }
 
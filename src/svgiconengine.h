@@ -29,15 +29,13 @@ class SvgIconEngine : public QIconEngine {
 
     QString                       name;
     std::shared_ptr<QSvgRenderer> renderer;
-
-    struct CacheEntry {
-        QPixmapCache::Key key;
-        QSize             size;
-    };
-    std::list<CacheEntry> normalCache, disabledCache;
+    QString                       cacheKey; // prefix of QPixmapCache keys, common for all the engines of one icon
 
 public:
-    SvgIconEngine(const QString &name, std::shared_ptr<QSvgRenderer> renderer) : name(name), renderer(renderer) { }
+    SvgIconEngine(const QString &name, std::shared_ptr<QSvgRenderer> renderer, const QString &cacheKey) :
+        name(name), renderer(renderer), cacheKey(cacheKey)
+    {
+    }
 
     QSize        actualSize(const QSize &size, QIcon::Mode mode, QIcon::State state) override;
     QIconEngine *clone() const override;
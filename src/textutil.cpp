@@ -2,10 +2,12 @@
 
 #include "coloropt.h"
 #include "common.h"
+#include "emoticonmatcher.h"
 #include "psiiconset.h"
 #include "psioptions.h"
 #include "rtparse.h"
 
+#include <QColor>
 #include <QTextDocument> // for escape()
 
 QString TextUtil::escape(const QString &plain) { return plain.toHtmlEscaped(); }
@@ -82,36 +84,44 @@ QString TextUtil::quote(const QString &toquote, int width, bool quoteEmpty)
     return quoted;
 }
 
+// appends the richtext form of the plain char at \a i and moves \a i past it.
+// \a lastSpace tells if the rich text so far ends with a space and is updated accordingly.
+static void plain2rich_char(QString &rich, const QString &plain, int &i, bool &lastSpace)
+{
+#ifdef Q_OS_WIN
+    if (plain[i] == '\r' && i + 1 < plain.length() && plain[i + 1] == '\n')
+        ++i; // Qt/Win sees \r\n as two new line chars
+#endif
+    const QChar c = plain[i++];
+    if (c == '\n')
+        rich += "<br>";
+    else if (c == ' ' && lastSpace)
+        rich += "&nbsp;"; // instead of pre-wrap, which prewraps \n as well
+    else if (c == '\t')
+        rich += "&nbsp; &nbsp; &nbsp; ";
+    else if (c == '<')
+        rich += "&lt;";
+    else if (c == '>')
+        rich += "&gt;";
+    else if (c == '\"')
+        rich += "&quot;";
+    else if (c == '\'')
+        rich += "&apos;";
+    else if (c == '&')
+        rich += "&amp;";
+    else
+        rich += c;
+    lastSpace = c == '\t' || (c == ' ' && !lastSpace);
+}
+
 QString TextUtil::plain2rich(const QString &plain)
 {
     QString rich;
-    int     col = 0;
+    bool    lastSpace = false;
 
-    for (int i = 0; i < int(plain.length()); ++i) {
-#ifdef Q_OS_WIN
-        if (plain[i] == '\r' && i + 1 < (int)plain.length() && plain[i + 1] == '\n')
-            ++i; // Qt/Win sees \r\n as two new line chars
-#endif
-        if (plain[i] == '\n') {
-            rich += "<br>";
-            col = 0;
-        } else if (plain[i] == ' ' && !rich.isEmpty() && rich[rich.size() - 1] == ' ')
-            rich += "&nbsp;"; // instead of pre-wrap, which prewraps \n as well
-        else if (plain[i] == '\t')
-            rich += "&nbsp; &nbsp; &nbsp; ";
-        else if (plain[i] == '<')
-            rich += "&lt;";
-        else if (plain[i] == '>')
-            rich += "&gt;";
-        else if (plain[i] == '\"')
-            rich += "&quot;";
-        else if (plain[i] == '\'')
-            rich += "&apos;";
-        else if (plain[i] == '&')
-            rich += "&amp;";
-        else
-            rich += plain[i];
-        ++col;
+    rich.reserve(plain.length());
+    for (int i = 0; i < plain.length();) {
+        plain2rich_char(rich, plain, i, lastSpace);
     }
 
     return rich;
@@ -224,13 +234,14 @@ QString TextUtil::resolveEntities(const QString &in)
     return out;
 }
 
-static bool linkify_pmatch(const QString &str1, int at, const QString &str2)
+static bool linkify_pmatch(const QString &str1, int at, const char *str2)
 {
-    if (str2.length() > (str1.length() - at))
+    const int len = int(qstrlen(str2));
+    if (len > (str1.length() - at))
         return false;
 
-    for (int n = 0; n < int(str2.length()); ++n) {
-        if (str1.at(n + at).toLower() != str2.at(n).toLower())
+    for (int n = 0; n < len; ++n) {
+        if (str1.at(n + at).toLower() != QChar::fromLatin1(str2[n]).toLower())
             return false;
     }
 
@@ -282,170 +293,311 @@ static bool linkify_okEmail(const QString &addy)
     return addy.indexOf("..") == -1;
 }
 
+// color of links, which is not needed for web views
+static QColor linkify_color()
+{
+#ifdef WEBKIT
+    return QColor();
+#else
+    return ColorOpt::instance()->color("options.ui.look.colors.messages.link");
+#endif
+}
+
+// opening <a> tag for a detected url
+static QString linkify_anchor(const QString &url, const QColor &linkColor)
+{
+    // attributes need to be encoded too.
+    QString href = linkify_htmlsafe(TextUtil::escape(url));
+#ifdef WEBKIT
+    Q_UNUSED(linkColor)
+    return QString("<a href=\"%1\">").arg(href);
+#else
+    // we have visited link as well but it's no applicable to QTextEdit or we have to track visited manually
+    return QString("<a href=\"%1\" style=\"color:%2\">").arg(href, linkColor.name());
+#endif
+}
+
+static bool linkify_isEmailChar(const QChar &c) { return c.isLetterOrNumber() || linkify_isOneOf(c, "_.-+"); }
+
+// index of a bracket in "()[]{}" or -1. closing brackets are odd
+static int linkify_bracket(const QChar &c)
+{
+    switch (c.unicode()) {
+    case '(':
+        return 0;
+    case ')':
+        return 1;
+    case '[':
+        return 2;
+    case ']':
+        return 3;
+    case '{':
+        return 4;
+    case '}':
+        return 5;
+    default:
+        return -1;
+    }
+}
+
+struct LinkifyPrefix {
+    const char *prefix;
+    int         skip; // the end of url is looked for after that many chars
+    const char *href; // prepended to the link to make the href
+};
+
+static const LinkifyPrefix linkifyPrefixes[] = {
+    { "xmpp:", 5, "" },   { "mailto:", 7, "" }, { "http://", 7, "" }, { "https://", 8, "" },
+    { "ftp://", 6, "" },  { "news://", 7, "" }, { "ed2k://", 7, "" }, { "file://", 7, "" },
+    { "magnet:", 7, "" }, { "www.", 0, "http://" }, { "ftp.", 0, "ftp://" },
+};
+
+// returns the first of linkifyPrefixes matching at \a at, or nullptr
+static const LinkifyPrefix *linkify_prefixAt(const QString &str, int at)
+{
+    switch (str.at(at).toLower().unicode()) { // cheap rejection of most of the chars
+    case 'e':
+    case 'f':
+    case 'h':
+    case 'm':
+    case 'n':
+    case 'w':
+    case 'x':
+        break;
+    default:
+        return nullptr;
+    }
+    for (const LinkifyPrefix &p : linkifyPrefixes) {
+        if (linkify_pmatch(str, at, p.prefix))
+            return &p;
+    }
+    return nullptr;
+}
+
 /**
  * takes a richtext string and heuristically adds links for uris of common protocols
  * @return a richtext string with link markup added
  */
 QString TextUtil::linkify(const QString &in)
 {
-    QString out = in;
-    int     x1, x2;
-    bool    isUrl, isAtStyle;
-    QString linked, link, href;
-
-    for (int n = 0; n < int(out.length()); ++n) {
-        isUrl     = false;
-        isAtStyle = false;
-        x1        = n;
-
-        if (linkify_pmatch(out, n, "xmpp:")) {
-            n += 5;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "mailto:")) {
-            n += 7;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "http://")) {
-            n += 7;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "https://")) {
-            n += 8;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "ftp://")) {
-            n += 6;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "news://")) {
-            n += 7;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "ed2k://")) {
-            n += 7;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "file://")) {
-            n += 7;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "magnet:")) {
-            n += 7;
-            isUrl = true;
-            href  = "";
-        } else if (linkify_pmatch(out, n, "www.")) {
-            isUrl = true;
-            href  = "http://";
-        } else if (linkify_pmatch(out, n, "ftp.")) {
-            isUrl = true;
-            href  = "ftp://";
-        } else if (linkify_pmatch(out, n, "@")) {
-            isAtStyle = true;
-            href      = "x-psi-atstyle:";
-        }
-
-        if (isUrl) {
-            // make sure the previous char is not alphanumeric
-            if (x1 > 0 && out.at(x1 - 1).isLetterOrNumber())
+    // the output is built while scanning, and what is already written to it is looked at
+    // when checking the chars before an url or an address, the same way it was done
+    // when links were replaced in place.
+    QString      out;
+    const int    len       = in.length();
+    const QColor linkColor = linkify_color();
+
+    out.reserve(len + len / 4);
+    for (int n = 0; n < len;) {
+        const LinkifyPrefix *prefix = linkify_prefixAt(in, n);
+        if (prefix) {
+            const int x1 = n;
+            // make sure the previous char is not alphanumeric.
+            // otherwise skip the prefix and the char after it
+            if (!out.isEmpty() && out.at(out.length() - 1).isLetterOrNumber()) {
+                n = qMin(len, x1 + prefix->skip + 1);
+                out += in.midRef(x1, n - x1);
                 continue;
+            }
 
             // find whitespace (or end)
-            QMap<QChar, int> brackets;
-            brackets['('] = brackets[')'] = brackets['['] = brackets[']'] = brackets['{'] = brackets['}'] = 0;
-            QMap<QChar, QChar> openingBracket;
-            openingBracket[')'] = '(';
-            openingBracket[']'] = '[';
-            openingBracket['}'] = '{';
-            for (x2 = n; x2 < int(out.length()); ++x2) {
-                if (out.at(x2).isSpace() || linkify_isOneOf(out.at(x2), "\"\'`<>") || linkify_pmatch(out, x2, "&quot;")
-                    || linkify_pmatch(out, x2, "&apos;") || linkify_pmatch(out, x2, "&gt;")
-                    || linkify_pmatch(out, x2, "&lt;")) {
+            int brackets[6] = { 0 }; // ()[]{}
+            int x2;
+            for (x2 = x1 + prefix->skip; x2 < len; ++x2) {
+                const QChar c = in.at(x2);
+                if (c.isSpace() || linkify_isOneOf(c, "\"\'`<>"))
+                    break;
+                if (c == '&'
+                    && (linkify_pmatch(in, x2, "&quot;") || linkify_pmatch(in, x2, "&apos;")
+                        || linkify_pmatch(in, x2, "&gt;") || linkify_pmatch(in, x2, "&lt;"))) {
                     break;
                 }
-                if (brackets.keys().contains(out.at(x2))) {
-                    ++brackets[out.at(x2)];
-                }
+                int b = linkify_bracket(c);
+                if (b != -1)
+                    ++brackets[b];
             }
-            int     len = x2 - x1;
-            QString pre = resolveEntities(out.mid(x1, x2 - x1));
+            QString pre = resolveEntities(in.mid(x1, x2 - x1));
 
             // go backward hacking off unwanted punctuation
             int cutoff;
             for (cutoff = pre.length() - 1; cutoff >= 0; --cutoff) {
-                if (!linkify_isOneOf(pre.at(cutoff), "!?,.()[]{}<>\""))
+                const QChar c = pre.at(cutoff);
+                if (!linkify_isOneOf(c, "!?,.()[]{}<>\""))
                     break;
-                if (linkify_isOneOf(pre.at(cutoff), ")]}")
-                    && brackets[pre.at(cutoff)] - brackets[openingBracket[pre.at(cutoff)]] <= 0) {
+                int b = linkify_bracket(c);
+                if (b != -1 && (b & 1) && brackets[b] - brackets[b - 1] <= 0)
                     break; // in theory, there could be == above, but these are urls, not math ;)
-                }
-                if (brackets.keys().contains(pre.at(cutoff))) {
-                    --brackets[pre.at(cutoff)];
-                }
+                if (b != -1)
+                    --brackets[b];
             }
             ++cutoff;
-            //++x2;
 
-            link = pre.mid(0, cutoff);
+            const QString link = pre.left(cutoff);
             if (!linkify_okUrl(link)) {
-                n = x1 + link.length();
+                n = qMin(len, x1 + link.length() + 1);
+                out += in.midRef(x1, n - x1);
                 continue;
             }
-            href += link;
-            // attributes need to be encoded too.
-            href = escape(href);
-            href = linkify_htmlsafe(href);
-            // printf("link: [%s], href=[%s]\n", link.latin1(), href.latin1());
-#ifdef WEBKIT
-            linked = QString("<a href=\"%1\">").arg(href);
-#else
-            auto linkColor = ColorOpt::instance()->color("options.ui.look.colors.messages.link");
-            // we have visited link as well but it's no applicable to QTextEdit or we have to track visited manually
-            linked = QString("<a href=\"%1\" style=\"color:%2\">").arg(href, linkColor.name());
-#endif
-            linked += (escape(link) + "</a>" + escape(pre.mid(cutoff)));
-            out.replace(x1, len, linked);
-            n = x1 + linked.length() - 1;
-        } else if (isAtStyle) {
+            out += linkify_anchor(QString::fromLatin1(prefix->href) + link, linkColor);
+            out += escape(link) + "</a>" + escape(pre.mid(cutoff));
+            n = x2;
+        } else if (in.at(n) == '@' && !out.isEmpty()) {
             // go backward till we find the beginning
-            if (x1 == 0)
+            int x1 = out.length();
+            while (x1 > 0 && linkify_isEmailChar(out.at(x1 - 1)))
+                --x1;
+
+            // go forward till we find the end
+            int x2 = n + 1;
+            while (x2 < len && linkify_isEmailChar(in.at(x2)))
+                ++x2;
+
+            const QString link = out.mid(x1) + in.mid(n, x2 - n);
+            if (!linkify_okEmail(link)) {
+                // the char next to the address is not looked at
+                const int end = qMin(len, x2 + 1);
+                out += in.midRef(n, end - n);
+                n = end;
+                continue;
+            }
+
+            out.chop(out.length() - x1);
+            out += QString("<a href=\"x-psi-atstyle:%1\">").arg(link) + link + "</a>";
+            n = x2;
+        } else {
+            out += in.at(n++);
+        }
+    }
+
+    return out;
+}
+
+/**
+ * Same as linkify(plain2rich(plain)) but done in a single pass over the plain text.
+ * Urls and addresses are detected on the plain text while it's being escaped, so the
+ * output doesn't have to be rescanned and copied around for each link.
+ * Quirks of the two pass version (like a tab right after an url) are kept on purpose,
+ * since both are used for the same messages (see unittest/textutil).
+ */
+QString TextUtil::plain2richLinkified(const QString &plain) { return plain2richLinkified(plain, linkify_color()); }
+
+/**
+ * Same as above with the color of links given, so it doesn't touch the options
+ * and could be used outside of the GUI thread.
+ */
+QString TextUtil::plain2richLinkified(const QString &plain, const QColor &linkColor)
+{
+    QString   rich;
+    bool      lastSpace = false; // as in plain2rich_char()
+    int       linkEnd   = 0;     // plain text before this position is already linked
+    const int len       = plain.length();
+
+    rich.reserve(len + len / 4);
+    for (int i = 0; i < len;) {
+        const LinkifyPrefix *prefix = linkify_prefixAt(plain, i);
+        if (prefix) {
+            // make sure the previous char is not alphanumeric.
+            // otherwise skip the prefix and one more char as linkify() does
+            if (i > 0 && plain.at(i - 1).isLetterOrNumber()) {
+                const int skipTo = i + prefix->skip + 1;
+                while (i < skipTo && i < len)
+                    plain2rich_char(rich, plain, i, lastSpace);
                 continue;
-            --x1;
-            for (; x1 >= 0; --x1) {
-                if (!linkify_isOneOf(out.at(x1), "_.-+") && !out.at(x1).isLetterOrNumber())
+            }
+
+            // find whitespace (or end)
+            int  brackets[6] = { 0 }; // ()[]{}
+            bool tabEnd      = false; // a tab is escaped to "&nbsp; ..." and its first &nbsp; becomes part of url
+            int  x2;
+            for (x2 = i + prefix->skip; x2 < len; ++x2) {
+                const QChar c = plain.at(x2);
+                if (c == '\t') {
+                    tabEnd = true;
                     break;
+                }
+                if (c.isSpace() || linkify_isOneOf(c, "\"\'`<>"))
+                    break;
+                int b = linkify_bracket(c);
+                if (b != -1)
+                    ++brackets[b];
             }
-            ++x1;
+            QString pre = plain.mid(i, x2 - i);
+            if (tabEnd)
+                pre += QChar(0xa0);
 
-            // go forward till we find the end
-            x2 = n + 1;
-            for (; x2 < int(out.length()); ++x2) {
-                if (!linkify_isOneOf(out.at(x2), "_.-+") && !out.at(x2).isLetterOrNumber())
+            // go backward hacking off unwanted punctuation
+            int cutoff;
+            for (cutoff = pre.length() - 1; cutoff >= 0; --cutoff) {
+                const QChar c = pre.at(cutoff);
+                if (!linkify_isOneOf(c, "!?,.()[]{}<>\""))
                     break;
+                int b = linkify_bracket(c);
+                if (b != -1 && (b & 1) && brackets[b] - brackets[b - 1] <= 0)
+                    break;
+                if (b != -1)
+                    --brackets[b];
+            }
+            ++cutoff;
+
+            const QString link = pre.left(cutoff);
+            if (!linkify_okUrl(link)) {
+                const int skipTo = i + link.length() + 1;
+                while (i < skipTo && i < len)
+                    plain2rich_char(rich, plain, i, lastSpace);
+                continue;
             }
+            rich += linkify_anchor(QString::fromLatin1(prefix->href) + link, linkColor);
+            rich += escape(link) + "</a>" + escape(pre.mid(cutoff));
+            i       = x2;
+            linkEnd = x2;
+            if (tabEnd) {
+                rich += " &nbsp; &nbsp; "; // the rest of the tab
+                ++i;
+            }
+            lastSpace = tabEnd;
+        } else if (plain.at(i) == '@' && i > 0) {
+            // go backward till we find the beginning
+            int x1 = i;
+            while (x1 > linkEnd && linkify_isEmailChar(plain.at(x1 - 1)))
+                --x1;
 
-            int len = x2 - x1;
-            link    = out.mid(x1, len);
-            // link = resolveEntities(link);
+            // go forward till we find the end
+            int x2 = i + 1;
+            while (x2 < len && linkify_isEmailChar(plain.at(x2)))
+                ++x2;
 
+            const QString link = plain.mid(x1, x2 - x1);
             if (!linkify_okEmail(link)) {
-                n = x1 + link.length();
+                // linkify() doesn't look for links at the char next to the address
+                const int skipTo = x2 + 1;
+                while (i < skipTo && i < len)
+                    plain2rich_char(rich, plain, i, lastSpace);
                 continue;
             }
 
-            href += link;
-            // printf("link: [%s], href=[%s]\n", link.latin1(), href.latin1());
-            linked = QString("<a href=\"%1\">").arg(href) + link + "</a>";
-            out.replace(x1, len, linked);
-            n = x1 + linked.length() - 1;
+            rich.chop(i - x1); // address chars are not escaped, so they are the same in rich text
+            rich += QString("<a href=\"x-psi-atstyle:%1\">").arg(link) + link + "</a>";
+            i         = x2;
+            linkEnd   = x2;
+            lastSpace = false;
+        } else {
+            plain2rich_char(rich, plain, i, lastSpace);
         }
     }
 
-    return out;
+    return rich;
 }
 
-// sickening
-QString TextUtil::emoticonify(const QString &in)
+/**
+ * Replaces emoticon texts in the plain text parts of \a in with <icon> tags.
+ * All the emoticons are searched at once by PsiIconset::emoticonMatcher().
+ */
+QString TextUtil::emoticonify(const QString &in) { return emoticonify(in, PsiIconset::instance()->emoticonMatcher()); }
+
+/**
+ * Same as above with the given \a matcher. A copy of PsiIconset's one could be used outside of the GUI thread.
+ */
+QString TextUtil::emoticonify(const QString &in, const EmoticonMatcher &matcher)
 {
     RTParse p(in);
     while (!p.atEnd()) {
@@ -453,71 +605,14 @@ QString TextUtil::emoticonify(const QString &in)
         QString str = p.next();
 
         int i = 0;
-        while (i >= 0) {
-            // find closest emoticon
-            int      ePos    = -1;
-            PsiIcon *closest = nullptr;
-
-            int foundPos = -1, foundLen = -1;
-
-            for (const Iconset *iconset : PsiIconset::instance()->emoticons) {
-                QListIterator<PsiIcon *> it = iconset->iterator();
-                while (it.hasNext()) {
-                    PsiIcon *icon = it.next();
-                    if (icon->regExp().isEmpty())
-                        continue;
-
-                    // some hackery
-                    int  iii = i;
-                    bool searchAgain;
-
-                    do {
-                        searchAgain = false;
-
-                        // find the closest match
-                        const QRegExp &rx = icon->regExp();
-                        int            n  = rx.indexIn(str, iii);
-                        if (n == -1)
-                            continue;
-
-                        if (ePos == -1 || n < ePos || (rx.matchedLength() > foundLen && n < ePos + foundLen)) {
-                            bool leftSpace  = n == 0 || (n > 0 && str[n - 1].isSpace());
-                            bool rightSpace = (n + rx.matchedLength() == int(str.length()))
-                                || (n + rx.matchedLength() < int(str.length())
-                                    && str[n + rx.matchedLength()].isSpace());
-                            // there must be whitespace at least on one side of the emoticon
-                            if (leftSpace || rightSpace) {
-                                ePos    = n;
-                                closest = icon;
-
-                                foundPos = n;
-                                foundLen = rx.matchedLength();
-                                break;
-                            }
-
-                            searchAgain = true;
-                        }
-
-                        iii = n + rx.matchedLength();
-                    } while (searchAgain);
-                }
-            }
-
-            QString s;
-            if (ePos == -1)
-                s = str.mid(i);
-            else
-                s = str.mid(i, ePos - i);
-            p.putPlain(s);
-
-            if (!closest)
-                break;
-
+        for (const EmoticonMatcher::Match &m : matcher.findAll(str)) {
+            p.putPlain(str.mid(i, m.pos - i));
             p.putRich(QString("<icon name=\"%1\" text=\"%2\" size=\"%3\" type=\"smiley\">")
-                          .arg(TextUtil::escape(closest->name()), TextUtil::escape(str.mid(foundPos, foundLen)),
+                          .arg(TextUtil::escape(m.iconName), TextUtil::escape(str.mid(m.pos, m.length)),
                                QString::number(-1.4)));
-            i = foundPos + foundLen;
+            i = m.pos + m.length;
         }
+        p.putPlain(str.mid(i));
     }
 
     QString out = p.output();
@@ -3,6 +3,8 @@
 
 #include <QtGlobal>
 
+class EmoticonMatcher;
+class QColor;
 class QString;
 
 namespace TextUtil {
@@ -15,8 +17,11 @@ QString plain2rich(const QString &);
 QString rich2plain(const QString &, bool collapseSpaces = true);
 QString resolveEntities(const QString &);
 QString linkify(const QString &);
+QString plain2richLinkified(const QString &);
+QString plain2richLinkified(const QString &, const QColor &linkColor);
 QString legacyFormat(const QString &);
 QString emoticonify(const QString &in);
+QString emoticonify(const QString &in, const EmoticonMatcher &matcher);
 QString img2title(const QString &in);
 
 QString prepareMessageText(const QString &text, bool isEmote = false, bool isHtml = false);
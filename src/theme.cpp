@@ -80,7 +80,7 @@ QWidget *Theme::previewWidget() { return d->previewWidget(); }
 bool Theme::isCompressed(const QFileInfo &fi)
 {
     QString sfx = fi.suffix();
-    return fi.isDir()
+    return !fi.isDir()
         && (sfx == QLatin1Literal("jisp") || sfx == QLatin1Literal("zip") || sfx == QLatin1Literal("theme"));
 }
 
@@ -198,7 +198,11 @@ const QString &Theme::filePath() const { return d->filepath; }
 /**
  * Sets the Theme directory (.zip archive) name.
  */
-void Theme::setFilePath(const QString &f) { d->filepath = f; }
+void Theme::setFilePath(const QString &f)
+{
+    d->filepath = f;
+    d->zip.reset();
+}
 
 /**
  * Returns additional Theme information.
@@ -17,11 +17,35 @@
  *
  */
 
+#ifndef NO_Theme_ZIP
+#define Theme_ZIP
+#endif
+
 #include "theme_p.h"
 
+#ifdef Theme_ZIP
+#include "zip/zip.h"
+#endif
+
 #include <QDir>
 #include <QDirIterator>
 
+#ifdef Theme_ZIP
+static QByteArray readZipFile(UnZip &z, const QString &baseName, const QString &fileName, bool *loaded = nullptr)
+{
+    QByteArray ba;
+    QString    n  = baseName + QLatin1Char('/') + fileName;
+    bool       ok = z.readFile(n, &ba);
+    if (!ok) {
+        ok = z.readFile(n.mid(baseName.count()), &ba);
+    }
+    if (loaded) {
+        *loaded = ok;
+    }
+    return ba;
+}
+#endif
+
 ThemePrivate::ThemePrivate(PsiThemeProvider *provider) :
     provider(provider), name(QObject::tr("Unnamed")), caseInsensitiveFS(false)
 {
@@ -43,9 +67,39 @@ QWidget *ThemePrivate::previewWidget() { return nullptr; }
 
 QByteArray ThemePrivate::loadData(const QString &fileName, bool *loaded) const
 {
+#ifdef Theme_ZIP
+    auto z = openedZip();
+    if (z) {
+        return readZipFile(*z, QFileInfo(filepath).completeBaseName(), fileName, loaded);
+    }
+#endif
     return Theme::loadData(fileName, filepath, caseInsensitiveFS, loaded);
 }
 
+/**
+ * Returns the archive of a compressed theme. It's opened and its directory is read
+ * only once, then it's kept open while the theme exists.
+ * Returns null for not compressed themes and broken archives.
+ */
+QSharedPointer<UnZip> ThemePrivate::openedZip() const
+{
+#ifdef Theme_ZIP
+    if (!zip) {
+        QFileInfo fi(filepath);
+        if (!Theme::isCompressed(fi)) {
+            return zip;
+        }
+        auto z = QSharedPointer<UnZip>::create(filepath);
+        if (!z->open()) {
+            return zip;
+        }
+        zip = z;
+    }
+    zip->setCaseSensitivity(caseInsensitiveFS ? UnZip::CS_Insensitive : UnZip::CS_Default);
+#endif
+    return zip;
+}
+
 //=================================================
 // Reource Loader
 //=================================================
@@ -112,32 +166,22 @@ public:
 
 #ifdef Theme_ZIP
 class ZipResourceLoader : public Theme::ResourceLoader {
-    UnZip   z;
-    QString baseName;
+    QSharedPointer<UnZip> z;
+    QString               baseName;
 
 public:
-    ZipResourceLoader(UnZip &&z, const QString &baseName) : z(std::move(z)), baseName(baseName) { }
+    ZipResourceLoader(const QSharedPointer<UnZip> &z, const QString &baseName) : z(z), baseName(baseName) { }
 
-    QByteArray loadData(const QString &fileName)
-    {
-        QString    n = baseName + QLatin1Char('/') + fileName;
-        QByteArray ba;
-
-        if (!z.readFile(n, &ba)) {
-            z.readFile(n.mid(baseName.count()), &ba);
-        }
-
-        return ba;
-    }
+    QByteArray loadData(const QString &fileName) { return readZipFile(*z, baseName, fileName); }
 
     bool fileExists(const QString &fileName)
     {
         QString n = baseName + QLatin1Char('/') + fileName;
 
-        if (z.fileExists(n)) {
+        if (z->fileExists(n)) {
             return true;
         }
-        return z.fileExists(n.mid(baseName.count()));
+        return z->fileExists(n.mid(baseName.count()));
     }
 };
 #endif
@@ -151,13 +195,10 @@ Theme::ResourceLoader *ThemePrivate::resourceLoader() const
         }
     }
 #ifdef Theme_ZIP
-    else if (Theme::isCompressed(fi)) {
-        UnZip z;
-        if (z.open()) {
-            if (caseInsensitiveFS) {
-                z.setCaseSensitivity(UnZip::CS_Insensitive);
-            }
-            return new ZipResourceLoader(std::move(z), fi.completeBaseName());
+    else {
+        auto z = openedZip();
+        if (z) {
+            return new ZipResourceLoader(z, fi.completeBaseName());
         }
     }
 #endif
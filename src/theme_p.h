@@ -23,8 +23,10 @@
 #include "theme.h"
 
 #include <QSharedData>
+#include <QSharedPointer>
 
 class QWidget;
+class UnZip;
 
 class ThemePrivate : public QSharedData {
 public:
@@ -37,8 +39,9 @@ public:
     QHash<QString, QString> info;
 
     // runtime info
-    QString filepath;
-    bool    caseInsensitiveFS;
+    QString                       filepath;
+    bool                          caseInsensitiveFS;
+    mutable QSharedPointer<UnZip> zip; // opened archive of a compressed theme. shared by all the loads
 
 public:
     ThemePrivate(PsiThemeProvider *provider);
@@ -53,6 +56,7 @@ public:
 
     QByteArray             loadData(const QString &fileName, bool *loaded = nullptr) const;
     Theme::ResourceLoader *resourceLoader() const;
+    QSharedPointer<UnZip>  openedZip() const;
 };
 
 #endif // THEME_P_H
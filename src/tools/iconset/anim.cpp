@@ -23,35 +23,91 @@
 
 //#include <QApplication>
 #include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QImage>
 #include <QImageReader>
 #include <QObject>
 #include <QThread>
 #include <QTimer>
 
+#include <algorithm>
+
 /**
  * \class Anim
  * \brief Class for handling animations
  *
  * Anim is a class that can load animations. Generally, it looks like
- * QMovie but it loads animations in one pass and stores it in memory.
+ * QMovie but it stores the decoded frames in memory. Only the first frame
+ * is decoded until the animation is played for the first time.
  *
- * Each frame of Anim is stored as Impix.
+ * Each frame of Anim is stored as Impix. All the running animations
+ * are driven by one shared timer.
  */
 
 static QThread *animMainThread = nullptr;
 
+// frames of paused animations are dropped after this time, all but the first one
+static const int releaseFramesTimeout = 60 * 1000;
+
 //! \if _hide_doc_
-class Anim::Private : public QObject, public QSharedData {
+/**
+ * Drives all the running animations with one timer, so there are no wakeups
+ * when nothing is animated, and drops the frames of the animations which
+ * were not shown for a while.
+ */
+class AnimClock : public QObject {
     Q_OBJECT
 public:
-    QTimer *frametimer;
+    static AnimClock *instance(bool create = true)
+    {
+        if (!instance_ && create) {
+            instance_ = new AnimClock();
+        }
+        return instance_;
+    }
+
+    ~AnimClock() { instance_ = nullptr; }
+
+    void schedule(Anim::Private *anim, int interval);
+    void unschedule(Anim::Private *anim);
+    void setIdle(Anim::Private *anim, bool idle);
+
+private slots:
+    void tick();
+    void releaseIdle();
 
+private:
+    AnimClock() : QObject(QCoreApplication::instance())
+    {
+        timer_.setSingleShot(true);
+        connect(&timer_, SIGNAL(timeout()), SLOT(tick()));
+        releaseTimer_.setInterval(releaseFramesTimeout);
+        connect(&releaseTimer_, SIGNAL(timeout()), SLOT(releaseIdle()));
+        clock_.start();
+    }
+
+    void arm(qint64 at);
+
+    static AnimClock *             instance_;
+    QTimer                         timer_, releaseTimer_;
+    QElapsedTimer                  clock_;
+    QHash<Anim::Private *, qint64> due_;           // running animation -> time of its next frame
+    QHash<Anim::Private *, qint64> idle_;          // paused animation with decoded frames -> time it was paused
+    qint64                         deadline_ = 0;  // when timer_ fires
+    bool                           ticking_  = false;
+};
+
+AnimClock *AnimClock::instance_ = nullptr;
+
+class Anim::Private : public QObject, public QSharedData {
+    Q_OBJECT
+public:
     bool empty;
     bool paused;
 
     int speed;
-    int lasttimerinterval;
 
     int looping, loop;
 
@@ -61,21 +117,23 @@ public:
         int   period = 100;
     };
 
-    QList<Frame> frames;
+    // Only the first frame is decoded until the animation is played. The
+    // rest is decoded from data on demand and dropped when it's paused for a while.
+    QByteArray   data;           // encoded frames, empty if all of them are always in frames
+    int          skipFrames = 0; // number of the frames in data stripped with stripFirstFrame()
+    int          count      = 0; // number of frames
+    QList<Frame> frames;         // decoded frames, all of them or just the first one
     int          frame;
+    bool         scheduled = false; // the clock may have it in due_ or idle_
 
 public:
     void init()
     {
-        frametimer = new QTimer();
         if (animMainThread && animMainThread != QThread::currentThread()) {
-            frametimer->moveToThread(animMainThread);
             moveToThread(animMainThread);
         }
-        QObject::connect(frametimer, SIGNAL(timeout()), this, SLOT(refresh()));
 
-        speed             = 120;
-        lasttimerinterval = -1;
+        speed = 120;
 
         looping = 0; // MNG movies doesn't have loop flag?
         loop    = 0;
@@ -89,13 +147,15 @@ public:
     {
         init();
 
-        speed             = from.speed;
-        lasttimerinterval = from.lasttimerinterval;
-        looping           = from.looping;
-        loop              = from.loop;
-        frame             = from.frame;
-        paused            = from.paused;
-        frames            = from.frames;
+        speed      = from.speed;
+        looping    = from.looping;
+        loop       = from.loop;
+        frame      = from.frame;
+        paused     = from.paused;
+        data       = from.data;
+        skipFrames = from.skipFrames;
+        count      = from.count;
+        frames     = from.frames;
 
         if (!paused)
             unpause();
@@ -109,6 +169,20 @@ public:
         buffer.open(QBuffer::ReadOnly);
         QImageReader reader(&buffer);
 
+        int imageCount = reader.supportsAnimation() ? reader.imageCount() : 0;
+        if (imageCount > 1) {
+            // the rest is decoded when the animation is played
+            data    = *ba;
+            count   = imageCount;
+            looping = reader.loopCount();
+            decode(1);
+            if (frames.isEmpty()) {
+                data.clear();
+                count = 0;
+            }
+            return;
+        }
+
         while (reader.canRead()) {
             QImage image = reader.read();
             if (!image.isNull()) {
@@ -143,23 +217,85 @@ public:
                 looping = 0;
             }
         }
+        count = frames.count();
     }
 
     ~Private()
     {
-        if (frametimer)
-            delete frametimer;
+        // the animations of the iconset loading threads start paused and die there unplayed,
+        // the clock never knew them. the played ones are in the GUI thread, like the clock
+        if (!scheduled) {
+            return;
+        }
+        if (AnimClock *clock = AnimClock::instance(false)) {
+            Q_ASSERT(QThread::currentThread() == clock->thread());
+            clock->unschedule(this);
+            clock->setIdle(this, false);
+        }
+    }
+
+    /**
+     * Decodes first \a n frames from data, if they are not decoded yet.
+     * Fewer frames than expected means broken data, so count is adjusted.
+     */
+    void decode(int n)
+    {
+        if (data.isEmpty() || frames.count() >= n) {
+            return;
+        }
+
+        QBuffer buffer(&data);
+        buffer.open(QBuffer::ReadOnly);
+        QImageReader reader(&buffer);
+
+        QList<Frame> decoded;
+        for (int i = 0; i < skipFrames + n && reader.canRead(); i++) {
+            QImage image = reader.read();
+            if (image.isNull()) {
+                break;
+            }
+            if (i < skipFrames) {
+                continue;
+            }
+            Frame newFrame;
+            newFrame.impix  = Impix(image);
+            newFrame.period = reader.nextImageDelay();
+            decoded.append(newFrame);
+        }
+        if (decoded.count() < n) {
+            count = decoded.count();
+        }
+        frames = decoded;
+        if (frame >= frames.count()) {
+            frame = 0;
+        }
+    }
+
+    void decodeAll() { decode(count); }
+
+    // drops everything but the first frame, it can be decoded again from data
+    void releaseFrames()
+    {
+        if (!data.isEmpty() && paused && frames.count() > 1) {
+            frames = frames.mid(0, 1);
+            frame  = 0;
+        }
     }
 
     void pause()
     {
-        paused = true;
-        frametimer->stop();
+        paused    = true;
+        scheduled = true;
+        AnimClock::instance()->unschedule(this);
+        AnimClock::instance()->setIdle(this, !data.isEmpty() && frames.count() > 1);
     }
 
     void unpause()
     {
-        paused = false;
+        paused    = false;
+        scheduled = true;
+        decodeAll();
+        AnimClock::instance()->setIdle(this, false);
         restartTimer();
     }
 
@@ -170,19 +306,16 @@ public:
             restartTimer();
     }
 
-    int numFrames() const { return frames.count(); }
+    int numFrames() const { return count; }
 
     void restartTimer()
     {
-        if (!paused && speed > 0) {
+        if (!paused && speed > 0 && !frames.isEmpty()) {
             int frameperiod = frames[frame].period;
             int i           = frameperiod >= 0 ? frameperiod * 100 / speed : 0;
-            if (i != lasttimerinterval || !frametimer->isActive()) {
-                lasttimerinterval = i;
-                frametimer->start(i);
-            }
+            AnimClock::instance()->schedule(this, i);
         } else {
-            frametimer->stop();
+            AnimClock::instance()->unschedule(this);
         }
     }
 
@@ -193,12 +326,12 @@ public slots:
     void refresh()
     {
         frame++;
-        if (frame >= numFrames()) {
+        if (frame >= frames.count()) {
             frame = 0;
 
             loop++;
             if (looping > 0 && loop >= looping) {
-                frame = numFrames() - 1;
+                frame = frames.count() - 1;
                 pause();
                 restart();
             }
@@ -208,6 +341,86 @@ public slots:
         restartTimer();
     }
 };
+
+void AnimClock::schedule(Anim::Private *anim, int interval)
+{
+    qint64 at = clock_.elapsed() + interval;
+    due_.insert(anim, at);
+    if (!ticking_) {
+        arm(at);
+    }
+}
+
+void AnimClock::unschedule(Anim::Private *anim)
+{
+    due_.remove(anim);
+    if (due_.isEmpty()) {
+        timer_.stop();
+    }
+}
+
+void AnimClock::setIdle(Anim::Private *anim, bool idle)
+{
+    if (idle) {
+        idle_.insert(anim, clock_.elapsed());
+        if (!releaseTimer_.isActive()) {
+            releaseTimer_.start();
+        }
+    } else if (idle_.remove(anim) && idle_.isEmpty()) {
+        releaseTimer_.stop();
+    }
+}
+
+// makes the timer fire not later than at
+void AnimClock::arm(qint64 at)
+{
+    if (timer_.isActive() && deadline_ <= at) {
+        return;
+    }
+    deadline_ = at;
+    timer_.start(int(qMax(qint64(0), at - clock_.elapsed())));
+}
+
+void AnimClock::tick()
+{
+    const qint64 now = clock_.elapsed();
+
+    QList<Anim::Private *> expired;
+    for (auto it = due_.constBegin(); it != due_.constEnd(); ++it) {
+        if (it.value() <= now) {
+            expired << it.key();
+        }
+    }
+
+    ticking_ = true; // refresh() reschedules, the timer is armed once below
+    for (Anim::Private *anim : expired) {
+        if (due_.contains(anim)) { // might be paused by a previous one
+            due_.remove(anim);
+            anim->refresh();
+        }
+    }
+    ticking_ = false;
+
+    if (!due_.isEmpty()) {
+        arm(*std::min_element(due_.constBegin(), due_.constEnd()));
+    }
+}
+
+void AnimClock::releaseIdle()
+{
+    const qint64 now = clock_.elapsed();
+    for (auto it = idle_.begin(); it != idle_.end();) {
+        if (now - it.value() >= releaseFramesTimeout) {
+            it.key()->releaseFrames();
+            it = idle_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (idle_.isEmpty()) {
+        releaseTimer_.stop();
+    }
+}
 //! \endif
 
 /**
@@ -258,7 +471,13 @@ int Anim::frameNumber() const { return d->frame; }
 /**
  * Returns Impix of animation frame number \a n.
  */
-const Impix &Anim::frame(int n) const { return d->frames[n].impix; }
+const Impix &Anim::frame(int n) const
+{
+    if (n >= d->frames.count()) {
+        const_cast<Private *>(d.constData())->decodeAll();
+    }
+    return d->frames[n].impix;
+}
 
 /**
  * Returns \c true if numFrames() == 0 and \c false otherwise.
@@ -356,7 +575,19 @@ void Anim::stripFirstFrame()
 {
     detach();
     if (numFrames() > 1) {
-        d->frames.takeFirst();
+        if (!d->data.isEmpty()) {
+            d->skipFrames++;
+        }
+        if (d->frames.count() == d->count) {
+            d->frames.takeFirst();
+            d->count--;
+            if (d->frame >= d->count)
+                d->frame = 0;
+        } else { // only the first one is decoded
+            d->frames.clear();
+            d->count--;
+            d->decode(1);
+        }
 
         if (!paused())
             restart();
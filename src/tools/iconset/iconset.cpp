@@ -37,6 +37,9 @@
 #include <QApplication>
 #include <QBuffer>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDomDocument>
 #include <QFile>
 #include <QFileInfo>
@@ -45,7 +48,10 @@
 #include <QLocale>
 #include <QObject>
 #include <QPainter>
+#include <QPixmapCache>
 #include <QRegExp>
+#include <QSaveFile>
+#include <QSet>
 #include <QSharedData>
 #include <QSharedDataPointer>
 #include <QSvgRenderer>
@@ -53,7 +59,6 @@
 #include <QThread>
 #include <QTimer>
 #ifdef ICONSET_SOUND
-#include <QDataStream>
 #include <qca_basic.h>
 #endif
 
@@ -63,6 +68,14 @@ static void moveToMainThread(QObject *obj)
         obj->moveToThread(Anim::mainThread());
 }
 
+// iconsets may be loaded in worker threads, but QPixmapCache and IconsetFactory are for the GUI thread only
+static bool isGuiThread() { return qApp && QThread::currentThread() == qApp->thread(); }
+
+// where the compiled iconsets are stored. see Iconset::setCachePath()
+static QString       iconsetCachePath;
+static const quint32 iconsetCacheMagic   = 0x50534943; // "PSIC"
+static const quint32 iconsetCacheVersion = 2;
+
 //----------------------------------------------------------------------------
 // Impix
 //----------------------------------------------------------------------------
@@ -250,6 +263,7 @@ public:
         anim           = nullptr;
         icon           = nullptr;
         activatedCount = 0;
+        cacheId        = nextCacheId();
     }
 
     ~Private()
@@ -277,8 +291,29 @@ public:
         anim           = from.anim ? new Anim(*from.anim) : nullptr;
         icon           = nullptr;
         activatedCount = from.activatedCount;
+        cacheId        = from.cacheId; // same pixels until one of them is modified
+    }
+
+    static int nextCacheId()
+    {
+        static QAtomicInt lastId;
+        return lastId.fetchAndAddRelaxed(1) + 1;
+    }
+
+    /**
+     * Makes the pixmaps rendered so far unreachable. Has to be called
+     * whenever the image data changes. Stale entries are evicted from
+     * QPixmapCache as it fills up.
+     */
+    void invalidatePixmaps()
+    {
+        cacheId = nextCacheId();
+        delete icon;
+        icon = nullptr;
     }
 
+    QString cacheKey() const { return QString("PsiIcon/%1").arg(cacheId); }
+
     void unloadAnim()
     {
         if (anim) {
@@ -306,19 +341,42 @@ signals:
 public:
     QPixmap pixmap(const QSize &desiredSize = QSize()) const
     {
+        if (!svgRenderer && (anim || !scalable)) { // nothing to render or animation frames which change all the time
+            QPixmap pix = anim ? anim->framePixmap() : impix.pixmap();
+            if (scalable)
+                return pix.scaled(desiredSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            return pix;
+        }
+
+        // rendered svg or rescaled raster image. shared by all the copies of the icon.
+        // rendered for the screen, so it stays sharp on high dpi displays
+        const bool  useCache = isGuiThread();
+        const qreal dpr      = useCache ? qApp->devicePixelRatio() : 1.0;
+        const auto  key      = QString("%1/%2x%3@%4")
+                             .arg(cacheKey())
+                             .arg(desiredSize.width())
+                             .arg(desiredSize.height())
+                             .arg(dpr);
+        QPixmap pix;
+        if (useCache && QPixmapCache::find(key, &pix)) {
+            return pix;
+        }
+
         if (svgRenderer) {
             QSize sz = desiredSize.isEmpty() ? svgRenderer->defaultSize()
                                              : svgRenderer->defaultSize().scaled(desiredSize, Qt::KeepAspectRatio);
-            QPixmap pix(sz);
+            pix = QPixmap(sz * dpr);
             pix.fill(Qt::transparent);
             QPainter p(&pix);
             svgRenderer->render(&p);
-            return pix;
+        } else {
+            pix = impix.pixmap().scaled(desiredSize * dpr, Qt::KeepAspectRatio, Qt::SmoothTransformation);
         }
+        pix.setDevicePixelRatio(dpr);
 
-        QPixmap pix = anim ? anim->framePixmap() : impix.pixmap();
-        if (scalable)
-            return pix.scaled(desiredSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        if (useCache) {
+            QPixmapCache::insert(key, pix);
+        }
         return pix;
     }
 
@@ -340,6 +398,7 @@ public:
     bool                          scalable = false;
 
     int activatedCount = 0;
+    int cacheId        = 0; // identifies the image data in QPixmapCache keys
     friend class PsiIcon;
 };
 //! \endif
@@ -457,8 +516,10 @@ QIcon PsiIcon::icon() const
     }
 
     if (d->svgRenderer) {
-        auto eng = new SvgIconEngine(d->name, d->svgRenderer);
-        return QIcon(eng);
+        // kept, so the pixmaps rendered by the engine are found again
+        const_cast<Private *>(d.data())->icon
+            = new QIcon(new SvgIconEngine(d->name, d->svgRenderer, QString("Svg%1").arg(d->cacheKey())));
+        return *d->icon;
     }
     const_cast<Private *>(d.data())->icon = new QIcon(d->impix.pixmap());
     return *d->icon;
@@ -512,10 +573,7 @@ void PsiIcon::setImpix(const Impix &impix, bool doDetach)
     }
 
     d->impix = impix;
-    if (d->icon) {
-        delete d->icon;
-        d->icon = nullptr;
-    }
+    d->invalidatePixmaps();
 
     emit d->pixmapChanged();
     emit d->iconModified();
@@ -722,11 +780,13 @@ bool PsiIcon::loadFromData(const QString &mime, const QByteArray &ba, bool isAni
         return ret;
 
     detach();
+    d->invalidatePixmaps();
     d->rawData     = ba;
     d->scalable    = isScalable;
     d->svgRenderer = nullptr;
     if (d->scalable) {
         d->svgRenderer = std::make_shared<QSvgRenderer>(ba);
+        moveToMainThread(d->svgRenderer.get());
         if (!d->svgRenderer->isValid()) {
             d->svgRenderer.reset();
             d->svgRenderer = nullptr;
@@ -860,6 +920,13 @@ private:
     QList<Iconset *> *            iconsets_;
     mutable QPixmap *             emptyPixmap_;
 
+    // name -> icon of all the registered iconsets, the first registered iconset wins
+    mutable QHash<QString, const PsiIcon *> index_;
+    mutable bool                            indexValid_ = false;
+
+    void updateIndex() const;
+    void indexIconset(const Iconset *) const;
+
 public:
     const QPixmap &emptyPixmap() const
     {
@@ -883,8 +950,9 @@ public:
         return list;
     }
 
-    void registerIconset(const Iconset *);
-    void unregisterIconset(const Iconset *);
+    void        registerIconset(const Iconset *);
+    void        unregisterIconset(const Iconset *);
+    static void iconsetChanged(const Iconset *);
 
 public:
     static IconsetFactoryPrivate *instance()
@@ -915,6 +983,9 @@ void IconsetFactoryPrivate::registerIconset(const Iconset *i)
 
     if (!iconsets_->contains(const_cast<Iconset *>(i))) {
         iconsets_->append(const_cast<Iconset *>(i));
+        if (indexValid_) {
+            indexIconset(i); // the last one, so it only fills in the names missing so far
+        }
     }
 }
 
@@ -922,26 +993,39 @@ void IconsetFactoryPrivate::unregisterIconset(const Iconset *i)
 {
     if (iconsets_ && iconsets_->contains(const_cast<Iconset *>(i))) {
         iconsets_->removeAll(const_cast<Iconset *>(i));
+        indexValid_ = false;
     }
 }
 
+/**
+ * Drops the index if \a i is registered. Called when the icons of \a i were changed.
+ * Iconsets are registered in the GUI thread only, so the ones loaded elsewhere are skipped at once.
+ */
+void IconsetFactoryPrivate::iconsetChanged(const Iconset *i)
+{
+    if (!isGuiThread() || !instance_ || !instance_->iconsets_) {
+        return;
+    }
+    if (instance_->iconsets_->contains(const_cast<Iconset *>(i))) {
+        instance_->indexValid_ = false;
+    }
+}
+
+/**
+ * Returns the icon \a name from the first registered iconset having it.
+ * The lookup goes through the index which is rebuilt after a registered
+ * iconset was removed or changed, so it doesn't depend on the number of iconsets.
+ */
 const PsiIcon *IconsetFactoryPrivate::icon(const QString &name) const
 {
     if (!iconsets_) {
         return nullptr;
     }
 
-    const PsiIcon *out = nullptr;
-    for (const Iconset *const iconset : *iconsets_) {
-        if (iconset) {
-            out = iconset->icon(name);
-        }
-
-        if (out) {
-            break;
-        }
+    if (!indexValid_) {
+        updateIndex();
     }
-    return out;
+    return index_.value(name);
 }
 
 void IconsetFactory::reset() { IconsetFactoryPrivate::reset(); }
@@ -1039,6 +1123,7 @@ private:
         // creation = "1900-01-01";
         homeUrl   = QString();
         iconSize_ = 16;
+        cacheable = true;
     }
 
 public:
@@ -1049,6 +1134,9 @@ public:
     QHash<QString, QString>    info;
     int                        iconSize_;
     QHash<QString, QByteArray> zipCache;
+    QSet<QString>              sources;        // files read by load(). the cache is valid while they are unchanged
+    bool                       cacheable;      // false if loaded icons refer to files which won't outlive the session
+    QSet<QString>              generatedNames; // names given to the anonymous icons. see loadIcon()
 
 public:
     Private() { init(); }
@@ -1078,7 +1166,11 @@ public:
 
     void clear()
     {
+        if (list.isEmpty()) {
+            return;
+        }
         dict.clear();
+        generatedNames.clear();
         while (!list.isEmpty()) {
             delete list.takeFirst();
         }
@@ -1113,12 +1205,15 @@ public:
             }
 
             ba = file.readAll();
+            sources += QFileInfo(file).absoluteFilePath();
         }
 #ifdef ICONSET_ZIP
         else { // else its zip or jisp file
             UnZip z(dir);
-            if (zipCache.isEmpty())
+            if (zipCache.isEmpty()) {
                 zipCache = z.unpackAll();
+                sources += fi.absoluteFilePath();
+            }
             ba = zipCache.value(fi.completeBaseName() + '/' + fileName);
         }
 #endif
@@ -1172,7 +1267,7 @@ public:
         }
     }
 
-    static int icon_counter; // used to give unique names to icons
+    static QAtomicInt icon_counter; // used to give unique names to icons
 
     // will return 'true' when icon is loaded ok
     bool loadKdeEmoticon(const QDomElement &emot, const QString &dir, QSize &size)
@@ -1236,6 +1331,7 @@ public:
             qWarning("failed to read emoticon: %s", qPrintable(baseFN));
             return false;
         }
+        sources += finfo.absoluteFilePath();
 
         // construct RegExp
         if (text.count()) {
@@ -1265,7 +1361,8 @@ public:
         QList<PsiIcon::IconText> text;
         QHash<QString, QString>  graphic, sound, object; // mime => filename
 
-        QString name       = QString::asprintf("icon_%04d", icon_counter++);
+        QString name       = QString::asprintf("icon_%04d", icon_counter.fetchAndAddRelaxed(1));
+        bool    named      = false;
         bool    isAnimated = false;
         bool    isImage    = false;
         bool    isScalable = false;
@@ -1291,7 +1388,8 @@ public:
             } else if (tag == "x") {
                 QString attr = e.attribute("xmlns");
                 if (attr == "name") {
-                    name = e.text();
+                    name  = e.text();
+                    named = true;
                 } else if (attr == "type") {
                     if (e.text() == "animation") {
                         isAnimated = true;
@@ -1396,6 +1494,7 @@ public:
 
                 out.writeRawData(data, data.size());
                 icon.setSound(path);
+                cacheable = false; // the unpacked sounds are removed on exit
                 return true;
 #endif
             } else {
@@ -1427,6 +1526,9 @@ public:
 
         if (loadSuccess) {
             append(name, new PsiIcon(icon));
+            if (!named) {
+                generatedNames += name;
+            }
         } else {
             qWarning("can't load icon because of unknown type");
         }
@@ -1509,10 +1611,256 @@ public:
         info        = from.info;
         iconSize_   = from.iconSize_;
     }
+
+    // The compiled cache is a QDataStream dump of the loaded iconset. Static images are stored
+    // decoded, so they are restored with a memcpy instead of going through the image plugins.
+    enum CachedGraphic : quint8 { CachedImage, CachedSvg, CachedAnim };
+
+    static QString cacheFileName(const QString &dir, Iconset::Format format)
+    {
+        if (iconsetCachePath.isEmpty() || dir.startsWith(QLatin1String(":/"))) {
+            return QString(); // only files on disk can be revalidated
+        }
+        QByteArray key = QFileInfo(dir).absoluteFilePath().toUtf8() + '/' + QByteArray::number(int(format));
+        return iconsetCachePath + '/'
+            + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".cache";
+    }
+
+    static void writeCachedImage(QDataStream &out, const QImage &image)
+    {
+        out << qint32(image.width()) << qint32(image.height()) << qint32(image.format())
+            << qint32(image.bytesPerLine()) << image.colorTable();
+        out.writeRawData(reinterpret_cast<const char *>(image.constBits()), image.bytesPerLine() * image.height());
+    }
+
+    static QImage readCachedImage(QDataStream &in)
+    {
+        qint32        width, height, format, bytesPerLine;
+        QVector<QRgb> colors;
+        in >> width >> height >> format >> bytesPerLine >> colors;
+        if (in.status() != QDataStream::Ok || format <= QImage::Format_Invalid || format >= QImage::NImageFormats) {
+            return QImage();
+        }
+
+        QImage image(width, height, QImage::Format(format));
+        if (image.isNull() || image.bytesPerLine() != bytesPerLine) {
+            return QImage();
+        }
+        image.setColorTable(colors);
+        const int size = bytesPerLine * height;
+        if (in.readRawData(reinterpret_cast<char *>(image.bits()), size) != size) {
+            return QImage();
+        }
+        return image;
+    }
+
+    static void writeCachedIcon(QDataStream &out, const PsiIcon *icon, bool generatedName)
+    {
+        out << icon->name() << generatedName << icon->mimeType() << icon->sound() << icon->regExp().pattern()
+            << quint32(icon->text().count());
+        for (const PsiIcon::IconText &t : icon->text()) {
+            out << t.lang << t.text;
+        }
+
+        // raw() would encode the pixmap if there is no data, and pixmaps are for the GUI thread only
+        const QByteArray &raw = icon->d->rawData;
+        if (icon->d->svgRenderer) {
+            out << quint8(CachedSvg) << raw << icon->isScalable();
+        } else if (icon->anim()) {
+            out << quint8(CachedAnim) << raw << icon->isScalable(); // frames are decoded on demand anyway
+        } else {
+            out << quint8(CachedImage) << raw << icon->isScalable();
+            writeCachedImage(out, icon->d->impix.image());
+        }
+    }
+
+    // a generated name is replaced with a new one, as the names have to be unique within the session
+    static PsiIcon *readCachedIcon(QDataStream &in, bool *generatedName)
+    {
+        QString name, mime, sound, regExp;
+        quint32 textCount;
+        in >> name >> *generatedName >> mime >> sound >> regExp >> textCount;
+        if (*generatedName) {
+            name = QString::asprintf("icon_%04d", icon_counter.fetchAndAddRelaxed(1));
+        }
+
+        QList<PsiIcon::IconText> text;
+        for (quint32 n = 0; n < textCount && in.status() == QDataStream::Ok; ++n) {
+            QString lang, t;
+            in >> lang >> t;
+            text.append(PsiIcon::IconText(lang, t));
+        }
+
+        quint8     graphic;
+        QByteArray raw;
+        bool       scalable;
+        in >> graphic >> raw >> scalable;
+        if (in.status() != QDataStream::Ok) {
+            return nullptr;
+        }
+
+        PsiIcon icon;
+        icon.blockSignals(true);
+        icon.setText(text);
+        icon.setName(name);
+        icon.setSound(sound);
+        if (!regExp.isEmpty()) {
+            icon.setRegExp(QRegExp(regExp));
+        }
+
+        switch (graphic) {
+        case CachedImage: {
+            QImage image = readCachedImage(in);
+            if (image.isNull()) {
+                return nullptr;
+            }
+            icon.d->impix    = image;
+            icon.d->rawData  = raw;
+            icon.d->mime     = mime;
+            icon.d->scalable = scalable;
+            break;
+        }
+        case CachedSvg:
+        case CachedAnim:
+            if (!icon.loadFromData(mime, raw, graphic == CachedAnim, scalable)) {
+                return nullptr;
+            }
+            break;
+        default:
+            return nullptr;
+        }
+
+        icon.blockSignals(false);
+        return new PsiIcon(icon);
+    }
+
+    void saveCache(const QString &fileName) const
+    {
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning("Iconset: can't write %s", qPrintable(fileName));
+            return;
+        }
+
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_5_6);
+        out << iconsetCacheMagic << iconsetCacheVersion;
+
+        out << quint32(sources.count());
+        for (const QString &source : sources) {
+            QFileInfo fi(source);
+            out << source << fi.size() << fi.lastModified().toMSecsSinceEpoch();
+        }
+
+        out << name << version << description << creation << homeUrl << authors << info << qint32(iconSize_);
+        out << quint32(list.count());
+        for (const PsiIcon *icon : list) {
+            writeCachedIcon(out, icon, generatedNames.contains(icon->name()));
+        }
+
+        if (out.status() != QDataStream::Ok) {
+            file.cancelWriting();
+        }
+        if (!file.commit()) {
+            qWarning("Iconset: can't write %s", qPrintable(fileName));
+        }
+    }
+
+    // would return 'false' if the cache is missing, broken or older than any of its sources
+    bool loadCache(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        // mapped, so it's read straight from the page cache
+        uchar *    map = file.map(0, file.size());
+        QByteArray ba  = map ? QByteArray::fromRawData(reinterpret_cast<const char *>(map), int(file.size()))
+                             : file.readAll();
+        QDataStream in(ba);
+        in.setVersion(QDataStream::Qt_5_6);
+
+        quint32 magic, cacheVersion, count;
+        in >> magic >> cacheVersion;
+        if (in.status() != QDataStream::Ok || magic != iconsetCacheMagic || cacheVersion != iconsetCacheVersion) {
+            return false;
+        }
+
+        QSet<QString> cachedSources;
+        in >> count;
+        for (quint32 n = 0; n < count && in.status() == QDataStream::Ok; ++n) {
+            QString source;
+            qint64  size, modified;
+            in >> source >> size >> modified;
+
+            QFileInfo fi(source);
+            if (!fi.exists() || fi.size() != size || fi.lastModified().toMSecsSinceEpoch() != modified) {
+                return false;
+            }
+            cachedSources += source;
+        }
+
+        Private cached;
+        qint32  iconSize;
+        in >> cached.name >> cached.version >> cached.description >> cached.creation >> cached.homeUrl
+            >> cached.authors >> cached.info >> iconSize;
+        cached.iconSize_ = iconSize;
+
+        in >> count;
+        for (quint32 n = 0; n < count && in.status() == QDataStream::Ok; ++n) {
+            bool     generatedName = false;
+            PsiIcon *icon          = readCachedIcon(in, &generatedName);
+            if (!icon) {
+                qWarning("Iconset: %s is broken", qPrintable(fileName));
+                return false;
+            }
+            cached.append(icon->name(), icon);
+            if (generatedName) {
+                cached.generatedNames += icon->name();
+            }
+        }
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+
+        setInformation(cached);
+        while (!cached.list.isEmpty()) {
+            PsiIcon *icon = cached.list.takeFirst();
+            cached.dict.remove(icon->name());
+            append(icon->name(), icon);
+        }
+        sources = cachedSources;
+        generatedNames += cached.generatedNames;
+        return true;
+    }
 };
 //! \endif
 
-int Iconset::Private::icon_counter = 0;
+QAtomicInt Iconset::Private::icon_counter;
+
+// here, as it needs Iconset::Private
+void IconsetFactoryPrivate::updateIndex() const
+{
+    index_.clear();
+    for (const Iconset *const iconset : *iconsets_) {
+        indexIconset(iconset);
+    }
+    indexValid_ = true;
+}
+
+// adds the icons of \a iconset which aren't provided by the iconsets indexed before
+void IconsetFactoryPrivate::indexIconset(const Iconset *iconset) const
+{
+    if (!iconset || !iconset->d) {
+        return;
+    }
+    for (auto it = iconset->d->dict.constBegin(); it != iconset->d->dict.constEnd(); ++it) {
+        if (!index_.contains(it.key())) {
+            index_.insert(it.key(), it.value());
+        }
+    }
+}
 
 // static int iconset_counter = 0;
 
@@ -1539,7 +1887,12 @@ Iconset::Iconset(const Iconset &from)
 /**
  * Destroys Iconset, and frees all allocated Icons.
  */
-Iconset::~Iconset() { IconsetFactoryPrivate::instance()->unregisterIconset(this); }
+Iconset::~Iconset()
+{
+    if (isGuiThread()) { // can't be registered otherwise
+        IconsetFactoryPrivate::instance()->unregisterIconset(this);
+    }
+}
 
 /**
  * Copies all Icons as well as additional information from Iconset \a from.
@@ -1547,6 +1900,7 @@ Iconset::~Iconset() { IconsetFactoryPrivate::instance()->unregisterIconset(this)
 Iconset &Iconset::operator=(const Iconset &from)
 {
     d = from.d;
+    IconsetFactoryPrivate::iconsetChanged(this); // may be registered with the old icons
 
     return *this;
 }
@@ -1559,7 +1913,16 @@ Iconset Iconset::copy() const
     return is;
 }
 
-void Iconset::detach() { d.detach(); }
+/**
+ * Makes the icons of this Iconset its own, so they could be changed. All the Iconset
+ * modifications start here. The icons may get new addresses, so the factory index is dropped
+ * if this Iconset is registered.
+ */
+void Iconset::detach()
+{
+    d.detach();
+    IconsetFactoryPrivate::iconsetChanged(this);
+}
 
 /**
  * Appends icons from Iconset \a from to this Iconset.
@@ -1627,6 +1990,14 @@ bool Iconset::load(const QString &dir, Format format)
         return false;
     }
 
+    const QString cacheFile = Private::cacheFileName(dir, format);
+    if (!cacheFile.isEmpty() && d->loadCache(cacheFile)) {
+        d->filename = dir;
+        d->sources.clear();
+        IconsetFactoryPrivate::iconsetChanged(this);
+        return true;
+    }
+
     ba = d->loadData(fileName, dir);
     if (!ba.isEmpty()) {
         QDomDocument doc;
@@ -1644,7 +2015,12 @@ bool Iconset::load(const QString &dir, Format format)
                    "Failed to load icondef.xml");
         qWarning("Iconset::load(\"%s\"): Failed to load icondef.xml", qPrintable(dir));
     }
+    if (ret && d->cacheable && !cacheFile.isEmpty()) {
+        d->saveCache(cacheFile);
+    }
     d->zipCache.clear();
+    d->sources.clear();
+    IconsetFactoryPrivate::iconsetChanged(this); // in case something was looked up while loading
 
     // QPixmap::setDefaultOptimization( optimization );
 
@@ -1822,4 +2198,13 @@ void Iconset::setSoundPrefs(QString unpackPath, QObject *receiver, const char *s
 #endif
 }
 
+/**
+ * Enables the compiled iconset cache. Every Iconset loaded from disk afterwards is
+ * stored in \a path after the first successful load(), and later load() calls read it
+ * from there as long as none of the iconset files has changed its size or modification time.
+ * Calling application MUST ensure that \a path is already created. If \a path is empty,
+ * the cache is disabled, which is the default.
+ */
+void Iconset::setCachePath(const QString &path) { iconsetCachePath = path; }
+
 #include "iconset.moc"
@@ -177,6 +177,8 @@ public:
 
 private:
     QSharedDataPointer<Private> d;
+
+    friend class Iconset;
 };
 
 class Iconset {
@@ -225,6 +227,7 @@ public:
 
     static bool isSourceAllowed(const QFileInfo &fi);
     static void setSoundPrefs(QString unpackPath, QObject *receiver, const char *slot);
+    static void setCachePath(const QString &path);
 
     Iconset copy() const;
     void    detach();
@@ -232,6 +235,8 @@ public:
 private:
     class Private;
     QSharedDataPointer<Private> d;
+
+    friend class IconsetFactoryPrivate;
 };
 
 class IconsetFactory {
@@ -113,6 +113,22 @@ private slots:
         delete copy1;
     }
 
+    // frames are decoded when the animation is played, and it's driven by the shared clock
+    void testAnimPlayback()
+    {
+        Anim anim(IconsetFactory::iconPtr("psi/chat")->raw());
+        QCOMPARE(anim.numFrames(), 15);
+        QVERIFY(!anim.frame(0).isNull());
+
+        anim.unpause();
+        QTRY_VERIFY(anim.frameNumber() > 0);
+        anim.pause();
+        QVERIFY(!anim.frame(14).isNull());
+
+        anim.stripFirstFrame();
+        QCOMPARE(anim.numFrames(), 14);
+    }
+
     void testIconStripping()
     {
         const PsiIcon *chat = IconsetFactory::iconPtr("psi/chat");
@@ -203,6 +219,130 @@ private slots:
         QIcon icon = chat->icon();
         QVERIFY(!icon.isNull());
     }
+
+    void testFactoryIndex()
+    {
+        Iconset small;
+        QVERIFY(small.load("iconsets/roster/small.jisp"));
+        const QString name = small.iterator().next()->name();
+        const PsiIcon *own = IconsetFactory::iconPtr(name);
+        QVERIFY(own);
+
+        // registered later, so it doesn't override icons of the default iconset
+        small.addToFactory();
+        QCOMPARE(IconsetFactory::iconPtr(name), own);
+
+        PsiIcon extra(*own);
+        small.setIcon("test/extra", extra);
+        QVERIFY(IconsetFactory::iconPtr("test/extra") == small.icon("test/extra"));
+
+        // a copy is not registered, its changes don't reach the factory
+        Iconset copy(small);
+        copy.setIcon("test/copy", extra);
+        QVERIFY(!IconsetFactory::iconPtr("test/copy"));
+        QVERIFY(IconsetFactory::iconPtr("test/extra") == small.icon("test/extra"));
+
+        small.removeFromFactory();
+        QVERIFY(!IconsetFactory::iconPtr("test/extra"));
+        QCOMPARE(IconsetFactory::iconPtr(name), own);
+    }
+
+    // roughly what the main window and the roster look up while starting
+    void benchmarkFactoryLookup()
+    {
+        QList<Iconset *> iconsets;
+        for (const QString &file : { "iconsets/roster/small.jisp", "iconsets/emoticons/puz.jisp",
+                                     "iconsets/system/crystal_system.jisp" }) {
+            for (int i = 0; i < 10; ++i) {
+                Iconset *is = new Iconset();
+                QVERIFY(is->load(file));
+                is->addToFactory();
+                iconsets << is;
+            }
+        }
+        const QStringList names = IconsetFactory::icons();
+
+        QBENCHMARK
+        {
+            for (int i = 0; i < 20; ++i) {
+                for (const QString &name : names) {
+                    IconsetFactory::iconPtr(name);
+                }
+            }
+        }
+
+        qDeleteAll(iconsets);
+    }
+
+    void testScaledPixmapCache()
+    {
+        const QByteArray svg = "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"16\" height=\"16\">"
+                               "<rect width=\"16\" height=\"16\" fill=\"red\"/></svg>";
+        PsiIcon icon;
+        QVERIFY(icon.loadFromData("image/svg+xml", svg, false, true));
+
+        // rendered once and shared by the copies
+        PsiIcon copy(icon);
+        QPixmap pix = icon.pixmap(QSize(32, 32));
+        QCOMPARE(pix.size(), QSize(32, 32));
+        QCOMPARE(copy.pixmap(QSize(32, 32)).cacheKey(), pix.cacheKey());
+        QVERIFY(icon.pixmap(QSize(24, 24)).cacheKey() != pix.cacheKey());
+
+        // new image data means new pixmaps
+        QImage img(8, 8, QImage::Format_ARGB32);
+        img.fill(Qt::blue);
+        QByteArray png;
+        QBuffer    buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        img.save(&buffer, "PNG");
+        QVERIFY(icon.loadFromData("image/png", png, false, true));
+        QPixmap scaled = icon.pixmap(QSize(32, 32));
+        QVERIFY(scaled.cacheKey() != pix.cacheKey());
+        QCOMPARE(scaled.toImage().pixelColor(16, 16), QColor(Qt::blue));
+        QCOMPARE(icon.pixmap(QSize(32, 32)).cacheKey(), scaled.cacheKey());
+    }
+
+    void testCompiledCache()
+    {
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+        Iconset::setCachePath(cacheDir.path());
+
+        Iconset parsed;
+        QVERIFY(parsed.load("iconsets/emoticons/puz.jisp"));
+        QCOMPARE(QDir(cacheDir.path()).entryList(QDir::Files).count(), 1);
+
+        Iconset cached;
+        QVERIFY(cached.load("iconsets/emoticons/puz.jisp"));
+        Iconset::setCachePath(QString());
+
+        QCOMPARE(cached.name(), parsed.name());
+        QCOMPARE(cached.authors(), parsed.authors());
+        QCOMPARE(cached.iconSize(), parsed.iconSize());
+        QCOMPARE(cached.fileName(), parsed.fileName());
+        QCOMPARE(cached.count(), parsed.count());
+
+        // the icons of puz.jisp are anonymous, so they get new names instead of the cached ones
+        Iconset       uncached;
+        QSet<QString> names;
+        QVERIFY(uncached.load("iconsets/emoticons/puz.jisp"));
+        for (const Iconset *is : { &parsed, &cached, &uncached }) {
+            for (const PsiIcon *icon : *is)
+                names += icon->name();
+        }
+        QCOMPARE(names.count(), parsed.count() * 3);
+
+        auto it = cached.begin();
+        for (const PsiIcon *icon : parsed) {
+            const PsiIcon *restored = *it++;
+            QCOMPARE(restored->mimeType(), icon->mimeType());
+            QCOMPARE(restored->regExp().pattern(), icon->regExp().pattern());
+            QCOMPARE(restored->text().count(), icon->text().count());
+            QCOMPARE(restored->raw(), icon->raw());
+            QCOMPARE(restored->isAnimated(), icon->isAnimated());
+            QCOMPARE(restored->impix().image(), icon->impix().image());
+        }
+    }
 };
 
 QTEST_MAIN(TestIconset)
@@ -0,0 +1,90 @@
+#include "chatview_te.h"
+#include "messageview.h"
+
+#include <QScrollBar>
+#include <QtTest/QtTest>
+
+// messages appended within one event loop turn are laid out and scrolled at once
+class TestChatView : public QObject {
+    Q_OBJECT
+private:
+    static const int messageCount = 10000;
+
+    static MessageView message(int n)
+    {
+        MessageView mv = MessageView::fromPlainText(
+            QString("message number %1, see http://example.com/%1 for details").arg(n), MessageView::Message);
+        mv.setMessageId(QString::number(n));
+        mv.setNick(n % 2 ? "alice" : "bob");
+        mv.setLocal(n % 2);
+        mv.setDateTime(QDateTime(QDate(2020, 1, 1), QTime(12, 0)).addSecs(n));
+        return mv;
+    }
+
+private slots:
+    void testBatch()
+    {
+        ChatView view(nullptr);
+        view.setSessionData(false, false, XMPP::Jid("bob@example.com"), "bob");
+        view.resize(400, 300);
+        view.show();
+
+        for (int i = 0; i < 100; ++i)
+            view.dispatchMessage(message(i));
+        QVERIFY(view.toPlainText().contains("message number 99,"));
+
+        QCoreApplication::processEvents();
+        QVERIFY(view.atBottom());
+        QVERIFY(view.verticalScrollBar()->maximum() > 0);
+    }
+
+    void testScrolledUpStays()
+    {
+        ChatView view(nullptr);
+        view.setSessionData(false, false, XMPP::Jid("bob@example.com"), "bob");
+        view.resize(400, 300);
+        view.show();
+
+        for (int i = 0; i < 100; ++i)
+            view.dispatchMessage(message(i));
+        QCoreApplication::processEvents();
+
+        view.verticalScrollBar()->setValue(0);
+        for (int i = 100; i < 200; ++i)
+            view.dispatchMessage(message(i));
+        QCoreApplication::processEvents();
+        QCOMPARE(view.verticalScrollBar()->value(), 0);
+    }
+
+    void benchmarkPerTurn()
+    {
+        QBENCHMARK_ONCE
+        {
+            ChatView view(nullptr);
+            view.setSessionData(false, false, XMPP::Jid("bob@example.com"), "bob");
+            view.resize(400, 300);
+            view.show();
+            for (int i = 0; i < messageCount; ++i) {
+                view.dispatchMessage(message(i));
+                QCoreApplication::processEvents(); // one edit block and layout per message
+            }
+        }
+    }
+
+    void benchmarkBatched()
+    {
+        QBENCHMARK_ONCE
+        {
+            ChatView view(nullptr);
+            view.setSessionData(false, false, XMPP::Jid("bob@example.com"), "bob");
+            view.resize(400, 300);
+            view.show();
+            for (int i = 0; i < messageCount; ++i)
+                view.dispatchMessage(message(i));
+            QCoreApplication::processEvents();
+        }
+    }
+};
+
+QTEST_MAIN(TestChatView)
+#include "testchatview.moc"
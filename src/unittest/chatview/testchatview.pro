@@ -0,0 +1,4 @@
+TARGET = testchatview
+SOURCES += testchatview.cpp
+
+include(../half_of_psi.pri)
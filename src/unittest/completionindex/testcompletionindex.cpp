@@ -0,0 +1,84 @@
+#include "completionindex.h"
+
+#include <QtTest/QtTest>
+
+class TestCompletionIndex : public QObject {
+    Q_OBJECT
+private slots:
+    void testPrefixRange()
+    {
+        CompletionIndex index;
+        index.insert("bob");
+        index.insert("Alice");
+        index.insert("alex");
+        index.insert("Bill");
+        index.insert("albert");
+
+        QCOMPARE(index.count(), 5);
+        QCOMPARE(index.words(), QStringList({ "albert", "alex", "Alice", "Bill", "bob" }));
+        QCOMPARE(index.startingWith("al"), QStringList({ "albert", "alex", "Alice" }));
+        QCOMPARE(index.startingWith("AL"), QStringList({ "albert", "alex", "Alice" }));
+        QCOMPARE(index.startingWith("ali"), QStringList({ "Alice" }));
+        QCOMPARE(index.startingWith("b"), QStringList({ "Bill", "bob" }));
+        QCOMPARE(index.startingWith(""), index.words());
+        QVERIFY(index.startingWith("c").isEmpty());
+        QVERIFY(index.startingWith("alicex").isEmpty());
+    }
+
+    void testRename()
+    {
+        // a nick change is a removal of the old nick and an insertion of the new one
+        CompletionIndex index;
+        index.insert("alice");
+        index.insert("bob");
+
+        index.remove("alice");
+        index.insert("zoe");
+
+        QVERIFY(!index.contains("alice"));
+        QVERIFY(index.contains("zoe"));
+        QVERIFY(index.startingWith("a").isEmpty());
+        QCOMPARE(index.words(), QStringList({ "bob", "zoe" }));
+
+        index.remove("nobody");
+        QCOMPARE(index.count(), 2);
+    }
+
+    void testCaseDuplicates()
+    {
+        CompletionIndex index;
+        index.insert("alice");
+        index.insert("Alice");
+        index.insert("ALICE");
+        index.insert("Alice");
+
+        QCOMPARE(index.count(), 3);
+        QCOMPARE(index.startingWith("alice").size(), 3);
+        QVERIFY(index.contains("Alice"));
+        QVERIFY(!index.contains("aLice"));
+
+        index.remove("Alice");
+        QCOMPARE(index.count(), 2);
+        QVERIFY(index.contains("alice"));
+        QVERIFY(index.contains("ALICE"));
+        QVERIFY(!index.contains("Alice"));
+    }
+
+    void testClear()
+    {
+        CompletionIndex index;
+        index.insert("alice");
+        index.insert("bob");
+
+        index.clear();
+        QCOMPARE(index.count(), 0);
+        QVERIFY(index.words().isEmpty());
+        QVERIFY(index.startingWith("a").isEmpty());
+
+        index.insert("carol");
+        QCOMPARE(index.words(), QStringList({ "carol" }));
+    }
+};
+
+QTEST_MAIN(TestCompletionIndex)
+#include "testcompletionindex.moc"
@@ -0,0 +1,4 @@
+TARGET = testcompletionindex
+SOURCES += testcompletionindex.cpp
+
+include(../half_of_psi.pri)
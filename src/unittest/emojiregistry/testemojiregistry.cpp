@@ -0,0 +1,75 @@
+#include "emojiregistry.h"
+
+#include <QtTest/QtTest>
+
+class TestEmojiRegistry : public QObject {
+    Q_OBJECT
+private slots:
+    void testIsEmoji()
+    {
+        auto &er = EmojiRegistry::instance();
+        QVERIFY(er.isEmoji("😀"));
+        QVERIFY(er.isEmoji("👍🏽")); // modifier sequence
+        QVERIFY(er.isEmoji("👨‍👩‍👧")); // ZWJ sequence
+        QVERIFY(er.isEmoji("©️"));
+        QVERIFY(!er.isEmoji("©"));
+        QVERIFY(!er.isEmoji("a"));
+        QVERIFY(!er.isEmoji("😀a"));
+        QVERIFY(!er.isEmoji(""));
+    }
+
+    void testFindEmoji()
+    {
+        auto &        er   = EmojiRegistry::instance();
+        const QString text = QString::fromUtf8("1 + 1 = 2 👍🏽, family: 👨‍👩‍👧");
+
+        int length = 0;
+        int pos    = er.findEmoji(text, 0, &length);
+        QCOMPARE(pos, text.indexOf(QString::fromUtf8("👍🏽")));
+        QCOMPARE(length, 4);
+
+        pos = er.findEmoji(text, pos + length, &length);
+        QCOMPARE(pos, text.indexOf(QString::fromUtf8("👨")));
+        QCOMPARE(length, 8);
+
+        QCOMPARE(er.findEmoji(text, pos + length), -1);
+    }
+
+    void testFindByName()
+    {
+        auto &er = EmojiRegistry::instance();
+
+        auto found = er.findByName("grinning");
+        QVERIFY(!found.empty());
+        QCOMPARE(found.front()->code, QString::fromUtf8("😀"));
+
+        found = er.findByName("Grin Swe");
+        QCOMPARE(found.size(), size_t(1));
+        QCOMPARE(found.front()->name, QString("grinning face with sweat"));
+
+        QVERIFY(er.findByName("xyzzy").empty());
+        QVERIFY(er.findByName("  ").empty());
+    }
+
+    void benchmarkFindEmoji()
+    {
+        auto &  er = EmojiRegistry::instance();
+        QString text;
+        for (int i = 0; i < 10000; ++i) {
+            text += QString::fromUtf8("some text with an emoji 👍🏽 in it. ");
+        }
+
+        int count = 0;
+        QBENCHMARK
+        {
+            count = 0;
+            int length;
+            for (int pos = er.findEmoji(text, 0, &length); pos != -1; pos = er.findEmoji(text, pos + length, &length))
+                ++count;
+        }
+        QCOMPARE(count, 10000);
+    }
+};
+
+QTEST_MAIN(TestEmojiRegistry)
+#include "testemojiregistry.moc"
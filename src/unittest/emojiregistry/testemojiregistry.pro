@@ -0,0 +1,4 @@
+TARGET = testemojiregistry
+SOURCES += testemojiregistry.cpp
+
+include(../half_of_psi.pri)
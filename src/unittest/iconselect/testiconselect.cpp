@@ -0,0 +1,67 @@
+#include "iconselect.h"
+#include "iconset.h"
+
+#include <QAbstractButton>
+#include <QAbstractScrollArea>
+#include <QLineEdit>
+#include <QScrollBar>
+#include <QSignalSpy>
+#include <QtTest/QtTest>
+
+// the popup paints only the visible icons, so it doesn't take longer to show with more of them
+class TestIconSelect : public QObject {
+    Q_OBJECT
+private:
+    static const int iconCount = 5000;
+
+    Iconset iconset;
+
+private slots:
+    void initTestCase()
+    {
+        for (int i = 0; i < iconCount; ++i) {
+            QImage image(16, 16, QImage::Format_ARGB32);
+            image.fill(QColor::fromHsv(i % 360, 255, 255));
+
+            PsiIcon icon;
+            icon.setName(QString("icon%1").arg(i));
+            icon.setText({ PsiIcon::IconText("", QString(":icon%1:").arg(i)) });
+            icon.setImpix(image);
+            iconset.setIcon(icon.name(), icon);
+        }
+    }
+
+    void benchmarkFirstPaint()
+    {
+        IconSelectPopup popup;
+        QElapsedTimer   timer;
+        timer.start();
+        popup.setIconset(iconset);
+        popup.popup(QPoint(0, 0));
+        QVERIFY(QTest::qWaitForWindowExposed(&popup));
+        QTest::setBenchmarkResult(timer.elapsed(), QTest::WalltimeMilliseconds);
+
+        // no widget per icon
+        QVERIFY(popup.findChildren<QAbstractButton *>().count() < 20);
+        QVERIFY(popup.findChild<QAbstractScrollArea *>("iconSelect")->verticalScrollBar()->maximum() > 0);
+    }
+
+    void testSearch()
+    {
+        IconSelectPopup popup;
+        popup.setIconset(iconset);
+        popup.popup(QPoint(0, 0));
+        QVERIFY(QTest::qWaitForWindowExposed(&popup));
+
+        QSignalSpy spy(&popup, SIGNAL(textSelected(QString)));
+        QLineEdit *search = popup.findChild<QLineEdit *>();
+        QVERIFY(search);
+        QTest::keyClicks(search, "icon4321");
+        QTest::keyClick(search, Qt::Key_Return);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.first().first().toString(), QString(":icon4321:"));
+    }
+};
+
+QTEST_MAIN(TestIconSelect)
+#include "testiconselect.moc"
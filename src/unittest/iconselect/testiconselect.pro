@@ -0,0 +1,4 @@
+TARGET = testiconselect
+SOURCES += testiconselect.cpp
+
+include(../half_of_psi.pri)
@@ -0,0 +1,142 @@
+#include "messageformatter.h"
+#include "messageview.h"
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtTest/QtTest>
+
+// large messages must not block the event loop while they are formatted,
+// and all the messages must come out in the order they went in
+class TestMessageFormatter : public QObject {
+    Q_OBJECT
+private:
+    QList<MessageView> received;
+
+    static QString largeText(int size)
+    {
+        QString       text;
+        const QString line = "a line of a pasted log, see http://example.com/log?line=1 & <more> :-) *bold*\n";
+        while (text.size() < size)
+            text += line;
+        return text;
+    }
+
+    static MessageView message(const QString &id, const QString &text)
+    {
+        MessageView mv(MessageView::Message);
+        mv.setMessageId(id);
+        mv.deferPlainText(text);
+        return mv;
+    }
+
+private slots:
+    void init() { received.clear(); }
+
+    void testSmallIsImmediate()
+    {
+        MessageFormatter f;
+        connect(&f, &MessageFormatter::ready, this, [this](const MessageView &mv) { received << mv; });
+
+        f.append(message("1", "hello"));
+        QCOMPARE(received.size(), 1);
+        QVERIFY(!f.isBusy());
+    }
+
+    void testOrder()
+    {
+        MessageFormatter f;
+        connect(&f, &MessageFormatter::ready, this, [this](const MessageView &mv) { received << mv; });
+
+        f.append(message("1", "before"));
+        f.append(message("2", largeText(MessageView::largeTextSize * 4)));
+        f.append(message("3", "after"));
+        f.append(message("4", largeText(MessageView::largeTextSize)));
+        f.append(message("5", "last"));
+
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), 5, 10000);
+        for (int i = 0; i < received.size(); ++i)
+            QCOMPARE(received[i].messageId(), QString::number(i + 1));
+        QVERIFY(!f.isBusy());
+    }
+
+    void testSameAsInGuiThread()
+    {
+        MessageFormatter f;
+        connect(&f, &MessageFormatter::ready, this, [this](const MessageView &mv) { received << mv; });
+
+        const QString text = largeText(MessageView::largeTextSize * 2);
+        f.append(message("1", text));
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), 1, 10000);
+
+        MessageView mv(MessageView::Message);
+        mv.setPlainText(text);
+        QCOMPARE(received[0].text(), mv.text());
+        QCOMPARE(received[0].formattedText(), mv.formattedText());
+    }
+
+    // file shares replace the body with their own markup
+    void testHtmlReplacesDeferredText()
+    {
+        MessageFormatter f;
+        connect(&f, &MessageFormatter::ready, this, [this](const MessageView &mv) { received << mv; });
+
+        MessageView mv = message("1", largeText(MessageView::largeTextSize * 2));
+        mv.setHtml("<a href=\"share:1\">file.txt</a>");
+        QVERIFY(!mv.needsFormatting());
+        f.append(mv);
+
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), 1, 10000);
+        QCOMPARE(received[0].text(), QString("<a href=\"share:1\">file.txt</a>"));
+    }
+
+    void testReceiptAndClear()
+    {
+        MessageFormatter f;
+        connect(&f, &MessageFormatter::ready, this, [this](const MessageView &mv) { received << mv; });
+
+        MessageView mv = message("1", largeText(MessageView::largeTextSize * 4));
+        mv.setAwaitingReceipt();
+        f.append(mv);
+        f.append(message("2", "after"));
+        QVERIFY(f.markReceived("1"));
+        QVERIFY(!f.markReceived("3"));
+
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), 2, 10000);
+        QVERIFY(!received[0].isAwaitingReceipt());
+
+        // nothing is handed back after a clear
+        f.append(message("3", largeText(MessageView::largeTextSize * 4)));
+        f.clear();
+        QVERIFY(!f.isBusy());
+        QTest::qWait(500);
+        QCOMPARE(received.size(), 2);
+    }
+
+    void testResponsiveness()
+    {
+        MessageFormatter f;
+        connect(&f, &MessageFormatter::ready, this, [this](const MessageView &mv) { received << mv; });
+
+        // the event loop keeps ticking while a 1 MB paste is formatted
+        QElapsedTimer sinceTick;
+        qint64        maxGap = 0;
+        QTimer        ticker;
+        ticker.setInterval(5);
+        connect(&ticker, &QTimer::timeout, this, [&]() { maxGap = qMax(maxGap, sinceTick.restart()); });
+
+        const MessageView mv = message("1", largeText(1024 * 1024));
+        QElapsedTimer     appendTime;
+        appendTime.start();
+        sinceTick.start();
+        ticker.start();
+        f.append(mv);
+        QVERIFY2(appendTime.elapsed() < 50, "append() is not supposed to format large messages itself");
+
+        QTRY_COMPARE_WITH_TIMEOUT(received.size(), 1, 30000);
+        ticker.stop();
+        QVERIFY2(maxGap < 100, qPrintable(QString("event loop was blocked for %1 ms").arg(maxGap)));
+    }
+};
+
+QTEST_MAIN(TestMessageFormatter)
+#include "testmessageformatter.moc"
@@ -0,0 +1,4 @@
+TARGET = testmessageformatter
+SOURCES += testmessageformatter.cpp
+
+include(../half_of_psi.pri)
@@ -63,6 +63,16 @@ private slots:
 
         option = oldOptions;
     }
+
+    // what PsiCon::init() waits for before the main window is shown
+    void benchmarkStartup()
+    {
+        QBENCHMARK
+        {
+            PsiIconset::reset();
+            QVERIFY(PsiIconset::instance()->loadAll());
+        }
+    }
 };
 
 QTEST_MAIN(TestPsiIconset)
@@ -0,0 +1,305 @@
+#include "coloropt.h"
+#include "textutil.h"
+
+#include <QMap>
+#include <QtTest/QtTest>
+
+// The original in-place linkify(), kept as the reference for the link boundaries.
+namespace Reference {
+static bool pmatch(const QString &str1, int at, const QString &str2)
+{
+    if (str2.length() > (str1.length() - at))
+        return false;
+    for (int n = 0; n < int(str2.length()); ++n) {
+        if (str1.at(n + at).toLower() != str2.at(n).toLower())
+            return false;
+    }
+    return true;
+}
+
+static bool isOneOf(const QChar &c, const QString &charlist) { return charlist.contains(c); }
+
+static QString htmlsafe(const QString &in)
+{
+    QString out;
+    for (int n = 0; n < in.length(); ++n) {
+        if (isOneOf(in.at(n), "\"\'`<>"))
+            out.append(QString::asprintf("%%%02X", in.at(n).toLatin1()));
+        else
+            out.append(in.at(n));
+    }
+    return out;
+}
+
+static bool okEmail(const QString &addy)
+{
+    int n = addy.indexOf('@');
+    if (n == -1 || n == 0)
+        return false;
+    int d = addy.indexOf('.', n + 1);
+    if (d == -1 || d == 0)
+        return false;
+    if ((addy.length() - 1) - d <= 0)
+        return false;
+    return addy.indexOf("..") == -1;
+}
+
+static QString linkify(const QString &in)
+{
+    static const char *prefixes[][2] = { { "xmpp:", "" },   { "mailto:", "" }, { "http://", "" }, { "https://", "" },
+                                         { "ftp://", "" },  { "news://", "" }, { "ed2k://", "" }, { "file://", "" },
+                                         { "magnet:", "" }, { "www.", "http://" }, { "ftp.", "ftp://" } };
+
+    QString out = in;
+    int     x1, x2;
+    QString linked, link, href;
+
+    for (int n = 0; n < int(out.length()); ++n) {
+        bool isUrl = false, isAtStyle = false;
+        x1         = n;
+        for (const auto &p : prefixes) {
+            if (pmatch(out, n, p[0])) {
+                if (!*p[1])
+                    n += int(qstrlen(p[0]));
+                isUrl = true;
+                href  = p[1];
+                break;
+            }
+        }
+        if (!isUrl && pmatch(out, n, "@")) {
+            isAtStyle = true;
+            href      = "x-psi-atstyle:";
+        }
+
+        if (isUrl) {
+            if (x1 > 0 && out.at(x1 - 1).isLetterOrNumber())
+                continue;
+
+            QMap<QChar, int> brackets;
+            brackets['('] = brackets[')'] = brackets['['] = brackets[']'] = brackets['{'] = brackets['}'] = 0;
+            QMap<QChar, QChar> openingBracket;
+            openingBracket[')'] = '(';
+            openingBracket[']'] = '[';
+            openingBracket['}'] = '{';
+            for (x2 = n; x2 < int(out.length()); ++x2) {
+                if (out.at(x2).isSpace() || isOneOf(out.at(x2), "\"\'`<>") || pmatch(out, x2, "&quot;")
+                    || pmatch(out, x2, "&apos;") || pmatch(out, x2, "&gt;") || pmatch(out, x2, "&lt;")) {
+                    break;
+                }
+                if (brackets.keys().contains(out.at(x2)))
+                    ++brackets[out.at(x2)];
+            }
+            int     len = x2 - x1;
+            QString pre = TextUtil::resolveEntities(out.mid(x1, x2 - x1));
+
+            int cutoff;
+            for (cutoff = pre.length() - 1; cutoff >= 0; --cutoff) {
+                if (!isOneOf(pre.at(cutoff), "!?,.()[]{}<>\""))
+                    break;
+                if (isOneOf(pre.at(cutoff), ")]}")
+                    && brackets[pre.at(cutoff)] - brackets[openingBracket[pre.at(cutoff)]] <= 0) {
+                    break;
+                }
+                if (brackets.keys().contains(pre.at(cutoff)))
+                    --brackets[pre.at(cutoff)];
+            }
+            ++cutoff;
+
+            link = pre.mid(0, cutoff);
+            if (link.endsWith('.')) {
+                n = x1 + link.length();
+                continue;
+            }
+            href += link;
+            href = htmlsafe(TextUtil::escape(href));
+#ifdef WEBKIT
+            linked = QString("<a href=\"%1\">").arg(href);
+#else
+            auto linkColor = ColorOpt::instance()->color("options.ui.look.colors.messages.link");
+            linked         = QString("<a href=\"%1\" style=\"color:%2\">").arg(href, linkColor.name());
+#endif
+            linked += (TextUtil::escape(link) + "</a>" + TextUtil::escape(pre.mid(cutoff)));
+            out.replace(x1, len, linked);
+            n = x1 + linked.length() - 1;
+        } else if (isAtStyle) {
+            if (x1 == 0)
+                continue;
+            --x1;
+            for (; x1 >= 0; --x1) {
+                if (!isOneOf(out.at(x1), "_.-+") && !out.at(x1).isLetterOrNumber())
+                    break;
+            }
+            ++x1;
+            x2 = n + 1;
+            for (; x2 < int(out.length()); ++x2) {
+                if (!isOneOf(out.at(x2), "_.-+") && !out.at(x2).isLetterOrNumber())
+                    break;
+            }
+
+            int len = x2 - x1;
+            link    = out.mid(x1, len);
+            if (!okEmail(link)) {
+                n = x1 + link.length();
+                continue;
+            }
+
+            href += link;
+            linked = QString("<a href=\"%1\">").arg(href) + link + "</a>";
+            out.replace(x1, len, linked);
+            n = x1 + linked.length() - 1;
+        }
+    }
+
+    return out;
+}
+} // namespace Reference
+
+// single pass plain2richLinkified() must give exactly what the old
+// linkify(plain2rich()) pipeline gives, quirks included.
+// linkify() must find the same links as the reference one.
+class TestTextUtil : public QObject {
+    Q_OBJECT
+private:
+    QString chatLog;
+    QString base64Blob;
+    QString codeSnippet;
+
+private slots:
+    void initTestCase()
+    {
+        const QStringList lines
+            = { "hi there, how are you?", "see http://example.com/path?a=1&b=2 for details.",
+                "mail me: someone@example.org", "(look at www.example.com/wiki/Foo_(bar)) now",
+                "<b>not html</b> & \"quotes\" 'too'", "  indented\twith\ttabs", "xmpp:room@conference.example.org?join",
+                "nothing special here at all, just a rather long line of chat text" };
+        for (int i = 0; i < 2000; ++i)
+            chatLog += lines[i % lines.size()] + '\n';
+
+        QByteArray blob;
+        for (int i = 0; i < 48 * 1024; ++i)
+            blob += char(i * 7919 % 251);
+        base64Blob = QString::fromLatin1(blob.toBase64());
+
+        for (int i = 0; i < 1000; ++i)
+            codeSnippet += QString("    if (x->%1 &amp;&amp; y[%1] &gt; 0) { www_%1(\"value@%1\", f.h(m)); } // "
+                                   "see http://example.com/%1\n")
+                               .arg(i);
+    }
+
+    void testGolden_data()
+    {
+        QTest::addColumn<QString>("plain");
+
+        QTest::newRow("empty") << "";
+        QTest::newRow("plain") << "hello world";
+        QTest::newRow("escaping") << "a < b && c > \"d\" 'e'";
+        QTest::newRow("spaces") << "  two   three    four ";
+        QTest::newRow("tabs") << "\ta\t\tb \t c";
+        QTest::newRow("newlines") << "line1\nline2\r\nline3\n\n";
+        QTest::newRow("http") << "go to http://example.com now";
+        QTest::newRow("https upper") << "HTTPS://Example.COM/A";
+        QTest::newRow("www") << "www.example.com, ftp.example.com.";
+        QTest::newRow("schemes") << "xmpp:a@b.c mailto:a@b.c ftp://x news://y ed2k://z file:///tmp magnet:?xt=1";
+        QTest::newRow("url at end") << "http://example.com/a.b.";
+        QTest::newRow("url punctuation") << "(http://example.com/a_(b))!?, [www.x.y] {ftp.x}";
+        QTest::newRow("url quoted") << "\"http://example.com\" 'http://example.org' <http://a.b> `www.c.d`";
+        QTest::newRow("url entities") << "http://example.com/?a=1&b=2&amp;c=3&lt;";
+        QTest::newRow("url tab") << "http://example.com.\tnext";
+        QTest::newRow("url newline") << "http://example.com\nwww.example.org";
+        QTest::newRow("prefix after word") << "xhttp://example.com awww.example.com ahttp://x@y.z";
+        QTest::newRow("prefix only") << "http:// www. ftp.";
+        QTest::newRow("email") << "write to john.doe+chat@mail.example.com.";
+        QTest::newRow("email chain") << "a@b.c@d.e a@b@c.d @x.y x@ @";
+        QTest::newRow("email bad") << "a@b a@.b a@b..c a@b. foo@bar";
+        QTest::newRow("email after entity") << "&a@b.c <a@b.c> \"a@b.c\"";
+        QTest::newRow("unicode") << QString::fromUtf8("привет http://пример.рф/путь и почта@пример.рф ok");
+        QTest::newRow("nbsp") << QString::fromUtf8("a\xc2\xa0http://b.c\xc2\xa0 d");
+        QTest::newRow("literal entities") << "&amp; &nbsp; &lt;http://x.y&gt;";
+    }
+
+    void testGolden()
+    {
+        QFETCH(QString, plain);
+        QCOMPARE(TextUtil::plain2richLinkified(plain), TextUtil::linkify(TextUtil::plain2rich(plain)));
+    }
+
+    // every sequence of up to three of the tokens, on top of the cases above
+    void testLinkifyCorpus()
+    {
+        const QStringList tokens = { "http://", "HTTPS://", "www.", "ftp.", "xmpp:", "mailto:", "@", "a", "1", ".",
+                                     "..", ",", "!", "(", ")", "]", "}", "<", ">", "\"", "'", "`", "&", "&amp;",
+                                     "&quot;", "&apos;", "&lt;", "&gt;", "&nbsp;", ";", " ", "\t", "<br>", "</a>",
+                                     "-", "_", "+", "/", ":", "b.cd" };
+
+        QStringList corpus { QString() };
+        for (int depth = 0, from = 0; depth < 3; ++depth) {
+            const int to = corpus.size();
+            for (int i = from; i < to; ++i) {
+                for (const QString &t : tokens)
+                    corpus << corpus[i] + t;
+            }
+            from = to;
+        }
+
+        for (const QString &text : corpus) {
+            const QString expected = Reference::linkify(text);
+            if (TextUtil::linkify(text) != expected) {
+                QCOMPARE(TextUtil::linkify(text), expected); // report the first mismatch
+                return;
+            }
+        }
+    }
+
+    void testLinkifyRich_data() { testGolden_data(); }
+
+    void testLinkifyRich()
+    {
+        QFETCH(QString, plain);
+        const QString rich = TextUtil::plain2rich(plain);
+        QCOMPARE(TextUtil::linkify(rich), Reference::linkify(rich));
+    }
+
+    void testPlain2Rich()
+    {
+        QCOMPARE(TextUtil::plain2rich("a  b\tc<d>&'\"\n"),
+                 QString("a &nbsp;b&nbsp; &nbsp; &nbsp; c&lt;d&gt;&amp;&apos;&quot;<br>"));
+        QCOMPARE(TextUtil::plain2richLinkified("mail a@b.cd."),
+                 QString("mail <a href=\"x-psi-atstyle:a@b.cd\">a@b.cd</a>."));
+    }
+
+    void benchmarkTwoPass()
+    {
+        QBENCHMARK { TextUtil::linkify(TextUtil::plain2rich(chatLog)); }
+    }
+
+    void benchmarkLinkify_data()
+    {
+        QTest::addColumn<QString>("text");
+
+        QTest::newRow("chat") << TextUtil::plain2rich(chatLog);
+        QTest::newRow("base64") << base64Blob;
+        QTest::newRow("code") << codeSnippet;
+    }
+
+    void benchmarkLinkify()
+    {
+        QFETCH(QString, text);
+        QBENCHMARK { TextUtil::linkify(text); }
+    }
+
+    void benchmarkReferenceLinkify_data() { benchmarkLinkify_data(); }
+
+    void benchmarkReferenceLinkify()
+    {
+        QFETCH(QString, text);
+        QBENCHMARK { Reference::linkify(text); }
+    }
+
+    void benchmarkSinglePass()
+    {
+        QBENCHMARK { TextUtil::plain2richLinkified(chatLog); }
+    }
+};
+
+QTEST_MAIN(TestTextUtil)
+#include "testtextutil.moc"
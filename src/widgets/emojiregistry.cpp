@@ -20,6 +20,13 @@
 #include "emojiregistry.h"
 #include "emojidb.cpp"
 
+#include <QRegExp>
+#include <QSet>
+
+#include <algorithm>
+
+static bool unitLess(const std::pair<ushort, int> &edge, ushort unit) { return edge.first < unit; }
+
 const EmojiRegistry &EmojiRegistry::instance()
 {
     static EmojiRegistry i;
@@ -28,25 +35,129 @@ const EmojiRegistry &EmojiRegistry::instance()
 
 bool EmojiRegistry::isEmoji(const QString &code) const
 {
-    if (code.isEmpty())
+    if (code.isEmpty() || emojiLength(code) != code.size())
         return false;
-    uint ucs = 0;
-    if (code[0].isHighSurrogate()) {
-        if (code.length() < 2)
-            return false;
-        ucs = QChar::surrogateToUcs4(code[0], code[1]);
-    } else {
-        ucs = code[0].unicode();
-        if (ucs < 256 && (code.size() < 2 || code[1].unicode() != 0xfe0f)) {
-            return false; // allow only full-qualified emojis from low range
+    if (code[0].unicode() < 256 && (code.size() < 2 || code[1].unicode() != 0xfe0f)) {
+        return false; // allow only full-qualified emojis from low range
+    }
+    return true;
+}
+
+int EmojiRegistry::emojiLength(const QString &text, int pos) const
+{
+    int node   = 0;
+    int length = 0;
+    for (int i = pos; i < text.size(); ++i) {
+        const ushort unit = text[i].unicode();
+        const auto & next = trie_[node].next;
+        auto         it   = std::lower_bound(next.begin(), next.end(), unit, unitLess);
+        if (it == next.end() || it->first != unit) {
+            break;
+        }
+        node = it->second;
+        if (trie_[node].emoji) {
+            length = i - pos + 1;
         }
     }
-    auto lb = ranges_.lower_bound(ucs);
-    if (lb == ranges_.end() || lb->first != ucs) {
-        --lb;
-        return (ucs > lb->first && ucs <= lb->second); // if this is a final range
+    return length;
+}
+
+int EmojiRegistry::findEmoji(const QString &text, int from, int *length) const
+{
+    for (int i = from; i < text.size(); ++i) {
+        // digits, '#' and '*' start keycap sequences, but alone they aren't emojis
+        const int len = emojiLength(text, i);
+        if (len && (text[i].unicode() >= 256 || (len > 1 && text[i + 1].unicode() == 0xfe0f))) {
+            if (length) {
+                *length = len;
+            }
+            return i;
+        }
     }
-    return lb->first == ucs;
+    return -1;
 }
 
-EmojiRegistry::EmojiRegistry() : groups(std::move(db)), ranges_(std::move(ranges)) { }
+std::vector<const EmojiRegistry::Emoji *> EmojiRegistry::findByName(const QString &query) const
+{
+    std::vector<const Emoji *> ret;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    const QStringList words = query.toLower().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+#else
+    const QStringList words = query.toLower().split(QLatin1Char(' '), QString::SkipEmptyParts);
+#endif
+    if (words.isEmpty()) {
+        return ret;
+    }
+
+    QSet<int> found;
+    for (int w = 0; w < words.size(); ++w) {
+        const QString &word = words[w];
+        QSet<int>      matches;
+        for (auto it = std::lower_bound(keywords_.begin(), keywords_.end(), std::make_pair(word, -1));
+             it != keywords_.end() && it->first.startsWith(word); ++it) {
+            if (w == 0 || found.contains(it->second)) {
+                matches.insert(it->second);
+            }
+        }
+        found = matches;
+    }
+
+    QList<int> indexes = found.values();
+    std::sort(indexes.begin(), indexes.end());
+    ret.reserve(size_t(indexes.size()));
+    for (int index : indexes) {
+        ret.push_back(emojis_[size_t(index)]);
+    }
+    return ret;
+}
+
+void EmojiRegistry::addSequence(const Emoji &emoji)
+{
+    int node = 0;
+    for (const QChar c : emoji.code) {
+        const ushort unit = c.unicode();
+        auto &       next = trie_[size_t(node)].next;
+        auto         it   = std::lower_bound(next.begin(), next.end(), unit, unitLess);
+        if (it != next.end() && it->first == unit) {
+            node = it->second;
+            continue;
+        }
+        const int child = int(trie_.size());
+        next.insert(it, std::make_pair(unit, child));
+        trie_.emplace_back(); // invalidates next
+        node = child;
+    }
+    trie_[size_t(node)].emoji = &emoji;
+}
+
+void EmojiRegistry::addKeywords(const QString &text, int index)
+{
+    static const QRegExp separators("[\\s,:\\-&]+");
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    for (const QString &word : text.toLower().split(separators, Qt::SkipEmptyParts)) {
+#else
+    for (const QString &word : text.toLower().split(separators, QString::SkipEmptyParts)) {
+#endif
+        keywords_.emplace_back(word, index);
+    }
+}
+
+EmojiRegistry::EmojiRegistry() : groups(std::move(db))
+{
+    trie_.emplace_back();
+    for (auto const &group : groups) {
+        for (auto const &subgroup : group.subGroups) {
+            for (auto const &emoji : subgroup.emojis) {
+                const int index = int(emojis_.size());
+                emojis_.push_back(&emoji);
+                addSequence(emoji);
+                addKeywords(emoji.name, index);
+                addKeywords(subgroup.name, index);
+                addKeywords(group.name, index);
+            }
+        }
+    }
+
+    std::sort(keywords_.begin(), keywords_.end());
+    keywords_.erase(std::unique(keywords_.begin(), keywords_.end()), keywords_.end());
+}
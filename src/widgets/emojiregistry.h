@@ -22,7 +22,6 @@
 
 #include <QString>
 
-#include <map>
 #include <vector>
 
 class EmojiRegistry {
@@ -49,12 +48,31 @@ public:
     // const QList<Group> &groups() const { return groups_; }
     bool isEmoji(const QString &code) const;
 
+    // length of the longest emoji sequence (with ZWJ, modifiers and so on) at position pos of text, or 0
+    int emojiLength(const QString &text, int pos = 0) const;
+
+    // position of the first emoji sequence in text at or after from, or -1. its length is stored in length
+    int findEmoji(const QString &text, int from = 0, int *length = nullptr) const;
+
+    // emojis having a word starting with each of the words of query in their names or group names, in db order
+    std::vector<const Emoji *> findByName(const QString &query) const;
+
 private:
     EmojiRegistry();
     EmojiRegistry(const EmojiRegistry &) = delete;
     EmojiRegistry &operator=(const EmojiRegistry &) = delete;
 
-    const std::map<quint32, quint32> ranges_; // start to end range mapping
+    struct Node {
+        std::vector<std::pair<ushort, int>> next;            // sorted by the code unit
+        const Emoji *                       emoji = nullptr; // set if a sequence ends here
+    };
+
+    void addSequence(const Emoji &emoji);
+    void addKeywords(const QString &text, int index);
+
+    std::vector<Node>                    trie_;     // over the UTF-16 code units of the sequences. trie_[0] is the root
+    std::vector<const Emoji *>           emojis_;   // all the emojis in db order
+    std::vector<std::pair<QString, int>> keywords_; // sorted lower-case words to the emojis_ index
 };
 
 #endif // EMOJIREGISTRY_H
@@ -23,190 +23,73 @@
 #include "iconset.h"
 #include "psitooltip.h"
 
-#include <QAbstractButton>
+#include <QAbstractScrollArea>
 #include <QApplication>
 #include <QDesktopWidget>
 #include <QEvent>
-#include <QLabel>
-#include <QLayout>
+#include <QHBoxLayout>
+#include <QHelpEvent>
+#include <QKeyEvent>
+#include <QLineEdit>
 #include <QMouseEvent>
 #include <QPainter>
-#include <QScrollArea>
 #include <QScrollBar>
+#include <QSet>
 #include <QStyle>
 #include <QStyleOption>
-#include <QTextCodec>
+#include <QToolButton>
+#include <QVBoxLayout>
 #include <QWidgetAction>
 
 #include <cmath>
 
 //----------------------------------------------------------------------------
-// IconSelectButton
+// IconSelect -- the widget that does all dirty work
 //----------------------------------------------------------------------------
 
 //! \if _hide_doc_
 /**
-    \class IconSelectButton
-    \brief This button is used by IconSelect and displays one PsiIcon
+    \class IconSelect
+    \brief Grid of icons, split into sections
+
+    Only the cells in the visible part of the viewport are painted, so the
+    number of icons doesn't matter for the time it takes to show the popup.
 */
-class IconSelectButton : public QAbstractButton {
+class IconSelect : public QAbstractScrollArea {
     Q_OBJECT
 
-private:
-    PsiIcon *ic;
-    QSize    s;
-    QSize    maxIconSize;
-    bool     animated;
-
 public:
-    IconSelectButton(QWidget *parent) : QAbstractButton(parent)
-    {
-        ic       = nullptr;
-        animated = false;
-        connect(this, SIGNAL(clicked()), SLOT(iconSelected()));
-    }
-
-    ~IconSelectButton()
-    {
-        iconStop();
-
-        if (ic) {
-            delete ic;
-            ic = nullptr;
-        }
-    }
-
-    void setIcon(const PsiIcon *i, const QSize &maxSize = QSize())
-    {
-        iconStop();
-
-        if (ic) {
-            delete ic;
-            ic = nullptr;
-        }
-
-        maxIconSize = maxSize;
-        if (i)
-            ic = new PsiIcon(*(const_cast<PsiIcon *>(i)));
-        else
-            ic = nullptr;
-    }
-
-    const PsiIcon *icon() const { return ic; }
-
-    QSize sizeHint() const { return s; }
-    void  setSizeHint(QSize sh) { s = sh; }
-
-signals:
-    void iconSelected(const PsiIcon *);
-    void textSelected(QString);
-
-private:
-    void iconStart()
-    {
-        if (ic) {
-            connect(ic, SIGNAL(pixmapChanged()), SLOT(iconUpdated()));
-            if (!animated) {
-                ic->activated(false);
-                animated = true;
-            }
-
-            if (!ic->text().isEmpty()) {
-                // and list of possible variants in the ToolTip
-                QStringList toolTip;
-                for (PsiIcon::IconText t : ic->text()) {
-                    toolTip += t.text;
-                }
-
-                QString toolTipText = toolTip.join(", ");
-                if (toolTipText.length() > 30)
-                    toolTipText = toolTipText.left(30) + "...";
-
-                setToolTip(toolTipText);
-            }
-        }
-    }
-
-    void iconStop()
-    {
-        if (ic) {
-            disconnect(ic, nullptr, this, nullptr);
-            if (animated) {
-                ic->stop();
-                animated = false;
-            }
-        }
-    }
-
-    void enterEvent(QEvent *)
-    {
-        iconStart();
-        setFocus();
-        update();
-    } // focus follows mouse mode
-    void leaveEvent(QEvent *)
-    {
-        iconStop();
-        clearFocus();
-        update();
-    }
-
-private slots:
-    void iconUpdated() { update(); }
-
-    void iconSelected()
-    {
-        clearFocus();
-        if (ic) {
-            emit iconSelected(ic);
-            emit textSelected(ic->defaultText());
-        }
-    }
-
-private:
-    // reimplemented
-    void paintEvent(QPaintEvent *)
-    {
-        QPainter                  p(this);
-        QFlags<QStyle::StateFlag> flags = QStyle::State_Active | QStyle::State_Enabled;
-
-        if (hasFocus())
-            flags |= QStyle::State_Selected;
-
-        QStyleOptionMenuItem opt;
-        opt.palette = palette();
-        opt.state   = flags;
-        opt.font    = font();
-        opt.rect    = rect();
-        style()->drawControl(QStyle::CE_MenuItem, &opt, &p, this);
-
-        if (ic) {
-            QPixmap pix = ic->pixmap(maxIconSize);
-            if (pix.width() > maxIconSize.width() || pix.height() > maxIconSize.height()) {
-                pix = pix.scaled(maxIconSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            }
-            p.drawPixmap((width() - pix.width()) / 2, (height() - pix.height()) / 2, pix);
-        }
-    }
-};
-//! \endif
-
-//----------------------------------------------------------------------------
-// IconSelect -- the widget that does all dirty work
-//----------------------------------------------------------------------------
-
-class IconSelect : public QWidget {
-    Q_OBJECT
+    struct Section {
+        QString                name;
+        QList<const PsiIcon *> icons;
+        int                    top = 0; // in content coordinates, see relayout()
+    };
 
 private:
-    IconSelectPopup *menu;
-    Iconset          is;
-    QGridLayout *    grid;
-    bool             shown;
-    bool             emojiSorting;
+    IconSelectPopup *               menu;
+    Iconset                         is;
+    bool                            emojiSorting = false;
+    QList<Section>                  groups;   // all icons by category
+    QList<Section>                  sections; // what's shown now: recently used + groups, or search results
+    QHash<const PsiIcon *, QString> searchText;
+    QHash<QString, const PsiIcon *> emojiIcons; // codepoint to icon map
+    QStringList                     recent; // icon names, most recent first
+    QString                         filter;
+
+    int   columns       = 1;
+    int   tileSize      = 0;
+    int   headerHeight  = 0;
+    int   margin        = 0;
+    int   contentHeight = 0;
+    QSize maxIconSize;
+
+    int      hoverSection = -1;
+    int      hoverIndex   = -1;
+    PsiIcon *hoverIcon    = nullptr; // animated copy of the hovered icon
 
 signals:
     void updatedGeometry();
+    void sectionsChanged();
 
 public:
     IconSelect(IconSelectPopup *parentMenu);
@@ -216,38 +99,55 @@ public:
     const Iconset &iconset() const;
 
     void setEmojiSortingEnabled(bool enabled);
+    void setFilter(const QString &text);
 
-protected:
-    QList<PsiIcon *> sortEmojis() const;
-    void             noIcons();
-    void             createLayout();
+    const QList<Section> &categories() const { return groups; }
+    QStringList           categoryNames() const;
+    void                  scrollToSection(const QString &name);
 
-    void paintEvent(QPaintEvent *)
-    {
-        QPainter p(this);
+    QSize sizeHint() const;
 
-        QStyleOptionMenuItem opt;
-        opt.palette = palette();
-        opt.rect    = rect();
-        style()->drawControl(QStyle::CE_MenuEmptyArea, &opt, &p, this);
-    }
+protected:
+    QString noIconsText() const { return tr("No icons available"); }
+    void    buildGroups();
+    void    buildSections();
+    void    relayout();
+    QRect   cellRect(int section, int index) const;
+    bool    itemAt(const QPoint &pos, int *section, int *index) const;
+    void    setHovered(int section, int index);
+    void    moveHover(int delta);
+    void    select(const PsiIcon *icon);
+
+    // reimplemented
+    void paintEvent(QPaintEvent *);
+    void resizeEvent(QResizeEvent *);
+    void mouseMoveEvent(QMouseEvent *);
+    void mouseReleaseEvent(QMouseEvent *);
+    void leaveEvent(QEvent *);
+    void keyPressEvent(QKeyEvent *);
+    bool viewportEvent(QEvent *);
 
 protected slots:
     void closeMenu();
+    void hoverIconUpdated();
 };
 
-IconSelect::IconSelect(IconSelectPopup *parentMenu) : QWidget(parentMenu)
+IconSelect::IconSelect(IconSelectPopup *parentMenu) : QAbstractScrollArea(parentMenu)
 {
     menu = parentMenu;
     connect(menu, SIGNAL(textSelected(QString)), SLOT(closeMenu()));
 
-    grid = nullptr;
-    noIcons();
-
-    Q_UNUSED(shown)
+    setObjectName("iconSelect");
+    setFrameStyle(QFrame::NoFrame);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setMouseTracking(true);
+    margin       = style()->pixelMetric(QStyle::PM_MenuPanelWidth, nullptr, this);
+    headerHeight = fontMetrics().height() + 4;
 }
 
-IconSelect::~IconSelect() { }
+IconSelect::~IconSelect() { setHovered(-1, -1); }
 
 void IconSelect::closeMenu()
 {
@@ -260,98 +160,44 @@ void IconSelect::closeMenu()
     menu->close();
 }
 
-void IconSelect::createLayout()
-{
-    Q_ASSERT(!grid);
-    grid = new QGridLayout(this);
-    grid->setMargin(style()->pixelMetric(QStyle::PM_MenuPanelWidth, nullptr, this));
-    grid->setSpacing(1);
-}
-
-void IconSelect::noIcons()
-{
-    createLayout();
-    QLabel *lbl = new QLabel(this);
-    grid->addWidget(lbl, 0, 0);
-    lbl->setText(tr("No icons available"));
-    emit updatedGeometry();
-}
-
 void IconSelect::setIconset(const Iconset &iconset)
 {
+    setHovered(-1, -1);
     is = iconset;
-
-    // delete all children
-    if (grid) {
-        delete grid;
-        grid = nullptr;
-
-        QObjectList list = children();
-        qDeleteAll(list);
-    }
-
-    if (!is.count()) {
-        noIcons();
-        return;
-    }
+    filter.clear();
 
     // first we need to find optimal size for elements and don't forget about
-    // taking too much screen space
+    // taking too much screen space. only the sizes are checked, the icons are
+    // rendered when they are painted.
     float w = 0, h = 0;
     int   maxPrefTileHeight = fontInfo().pixelSize() * 2;
-    auto  maxPrefSize       = QSize(maxPrefTileHeight, maxPrefTileHeight);
-
-    double                   count; // the 'double' type is somewhat important for MSVC.NET here
-    QListIterator<PsiIcon *> it = is.iterator();
-    for (count = 0; it.hasNext(); count++) {
-        PsiIcon *icon    = it.next();
-        auto     pix     = icon->pixmap(maxPrefSize);
-        auto     pixSize = pix.size();
-        if (pix.width() > maxPrefSize.width() || pix.height() > maxPrefSize.height()) {
-            pixSize.scale(maxPrefSize, Qt::KeepAspectRatio);
+    maxIconSize             = QSize(maxPrefTileHeight, maxPrefTileHeight);
+
+    for (const PsiIcon *icon : is) {
+        QSize pixSize = icon->size(maxIconSize);
+        if (pixSize.width() > maxIconSize.width() || pixSize.height() > maxIconSize.height()) {
+            pixSize.scale(maxIconSize, Qt::KeepAspectRatio);
         }
         w += pixSize.width();
         h += pixSize.height();
     }
-    w /= float(count);
-    h /= float(count);
-
-    const int margin   = 2;
-    int       tileSize = int(qMax(w, h)) + 2 * margin;
-
-    QRect r       = QApplication::desktop()->availableGeometry(menu);
-    int   maxSize = qMin(r.width(), r.height()) / 3;
-
-    int size       = int(ceil(std::sqrt(count)));
-    int maxColumns = int(maxSize / tileSize);
-    size           = size > maxColumns ? maxColumns : size;
-
-    // now, fill grid with elements
-    createLayout();
-    count = 0;
-
-    int row    = 0;
-    int column = 0;
-
-    QList<PsiIcon *> sortIcons;
-    if (emojiSorting) {
-        sortIcons = sortEmojis();
-        it        = QListIterator<PsiIcon *>(sortIcons);
-    } else
-        it = is.iterator();
-    while (it.hasNext()) {
-        IconSelectButton *b = new IconSelectButton(this);
-        grid->addWidget(b, row, column);
-        b->setIcon(it.next(), maxPrefSize);
-        b->setSizeHint(QSize(tileSize, tileSize));
-        connect(b, SIGNAL(iconSelected(const PsiIcon *)), menu, SIGNAL(iconSelected(const PsiIcon *)));
-        connect(b, &IconSelectButton::textSelected, menu, &IconSelectPopup::textSelected);
-
-        if (++column >= size) {
-            ++row;
-            column = 0;
-        }
+    const int count = is.count();
+    if (count) {
+        w /= float(count);
+        h /= float(count);
     }
+
+    const int iconMargin = 2;
+    tileSize             = qMax(int(qMax(w, h)) + 2 * iconMargin, 1);
+
+    QRect r          = QApplication::desktop()->availableGeometry(menu);
+    int   maxSize    = qMin(r.width(), r.height()) / 3;
+    int   maxColumns = qMax(maxSize / tileSize, 1);
+    columns          = qBound(1, int(ceil(std::sqrt(double(count)))), maxColumns);
+
+    buildGroups();
+    buildSections();
+    emit sectionsChanged();
     emit updatedGeometry();
 }
 
@@ -359,20 +205,37 @@ const Iconset &IconSelect::iconset() const { return is; }
 
 void IconSelect::setEmojiSortingEnabled(bool enabled) { emojiSorting = enabled; }
 
-QList<PsiIcon *> IconSelect::sortEmojis() const
+void IconSelect::buildGroups()
 {
-    QList<PsiIcon *> ret;
-    QList<PsiIcon *> notEmoji;
-    ret.reserve(is.count());
-    QHash<QString, PsiIcon *> cp2icon; // codepoint to icon map
+    groups.clear();
+    searchText.clear();
+    emojiIcons.clear();
+    for (const PsiIcon *icon : is) {
+        QStringList texts;
+        for (const PsiIcon::IconText &t : icon->text()) {
+            texts += t.text;
+        }
+        searchText.insert(icon, texts.join(' ').toLower());
+    }
+
+    if (!emojiSorting) {
+        Section all;
+        for (const PsiIcon *icon : is) {
+            all.icons.append(icon);
+        }
+        groups.append(all);
+        return;
+    }
+
+    QList<const PsiIcon *> notEmoji;
 
     auto &er = EmojiRegistry::instance();
 
-    for (const auto &icon : is) {
+    for (const PsiIcon *icon : is) {
         bool found = false;
         for (const auto &text : icon->text()) {
             if (er.isEmoji(text.text)) {
-                cp2icon.insert(text.text, icon);
+                emojiIcons.insert(text.text, icon);
                 found = true;
                 break;
             }
@@ -381,21 +244,394 @@ QList<PsiIcon *> IconSelect::sortEmojis() const
             notEmoji.append(icon);
     }
 
-    for (auto const &group : EmojiRegistry::instance().groups) {
+    for (auto const &group : er.groups) {
+        Section section;
+        section.name = group.name;
         for (auto const &subgroup : group.subGroups) {
             for (auto const &emoji : subgroup.emojis) {
-                auto icon = cp2icon.value(emoji.code);
+                auto icon = emojiIcons.value(emoji.code);
                 if (icon) {
-                    ret.append(icon);
+                    section.icons.append(icon);
+                }
+            }
+        }
+        if (!section.icons.isEmpty()) {
+            groups.append(section);
+        }
+    }
+
+    if (!notEmoji.isEmpty()) {
+        Section other;
+        other.name  = groups.isEmpty() ? QString() : tr("Other");
+        other.icons = notEmoji;
+        groups.append(other);
+    }
+}
+
+void IconSelect::buildSections()
+{
+    setHovered(-1, -1);
+    sections.clear();
+
+    if (!filter.isEmpty()) {
+        QSet<const PsiIcon *> named;
+        for (const EmojiRegistry::Emoji *emoji : EmojiRegistry::instance().findByName(filter)) {
+            const PsiIcon *icon = emojiIcons.value(emoji->code);
+            if (icon) {
+                named.insert(icon);
+            }
+        }
+
+        Section found;
+        for (const Section &group : groups) {
+            for (const PsiIcon *icon : group.icons) {
+                if (named.contains(icon) || searchText.value(icon).contains(filter)) {
+                    found.icons.append(icon);
                 }
             }
         }
+        sections.append(found);
+    } else {
+        Section recentlyUsed;
+        recentlyUsed.name = tr("Recently used");
+        for (const QString &name : recent) {
+            const PsiIcon *icon = is.icon(name);
+            if (icon && recentlyUsed.icons.count() < columns) {
+                recentlyUsed.icons.append(icon);
+            }
+        }
+        if (!recentlyUsed.icons.isEmpty()) {
+            sections.append(recentlyUsed);
+        }
+        sections += groups;
     }
 
-    ret += notEmoji;
-    return ret;
+    relayout();
+    verticalScrollBar()->setValue(0);
+    if (!filter.isEmpty() && !sections.first().icons.isEmpty()) {
+        setHovered(0, 0); // so Return picks the best match
+    }
 }
 
+QStringList IconSelect::categoryNames() const
+{
+    QStringList names;
+    for (const Section &section : sections) {
+        if (!section.name.isEmpty()) {
+            names += section.name;
+        }
+    }
+    return names;
+}
+
+void IconSelect::setFilter(const QString &text)
+{
+    QString f = text.trimmed().toLower();
+    if (f == filter) {
+        return;
+    }
+    filter = f;
+    buildSections();
+    viewport()->update();
+}
+
+void IconSelect::scrollToSection(const QString &name)
+{
+    setFilter(QString());
+    for (const Section &section : sections) {
+        if (section.name == name) {
+            verticalScrollBar()->setValue(section.top);
+            return;
+        }
+    }
+}
+
+void IconSelect::relayout()
+{
+    int y = margin;
+    for (Section &section : sections) {
+        section.top = y;
+        if (!section.name.isEmpty()) {
+            y += headerHeight;
+        }
+        y += (section.icons.count() + columns - 1) / columns * tileSize;
+    }
+    contentHeight = y + margin;
+
+    verticalScrollBar()->setRange(0, qMax(0, contentHeight - viewport()->height()));
+    verticalScrollBar()->setPageStep(viewport()->height());
+    verticalScrollBar()->setSingleStep(tileSize);
+}
+
+QSize IconSelect::sizeHint() const
+{
+    if (!is.count()) {
+        return QSize(fontMetrics().boundingRect(noIconsText()).width() + 2 * margin, headerHeight + 2 * margin);
+    }
+    return QSize(columns * tileSize + 2 * margin, contentHeight);
+}
+
+QRect IconSelect::cellRect(int section, int index) const
+{
+    const Section &s = sections[section];
+    int            y = s.top + (s.name.isEmpty() ? 0 : headerHeight) + index / columns * tileSize;
+    return QRect(margin + index % columns * tileSize, y - verticalScrollBar()->value(), tileSize, tileSize);
+}
+
+bool IconSelect::itemAt(const QPoint &pos, int *section, int *index) const
+{
+    if (pos.x() < margin || pos.x() >= margin + columns * tileSize) {
+        return false;
+    }
+    const int y = pos.y() + verticalScrollBar()->value();
+    for (int i = sections.count() - 1; i >= 0; --i) {
+        const Section &s = sections[i];
+        if (y < s.top) {
+            continue;
+        }
+        int cellsY = y - s.top - (s.name.isEmpty() ? 0 : headerHeight);
+        if (cellsY < 0) {
+            return false; // on the header
+        }
+        int n = cellsY / tileSize * columns + (pos.x() - margin) / tileSize;
+        if (n >= s.icons.count()) {
+            return false;
+        }
+        *section = i;
+        *index   = n;
+        return true;
+    }
+    return false;
+}
+
+void IconSelect::setHovered(int section, int index)
+{
+    if (section == hoverSection && index == hoverIndex) {
+        return;
+    }
+    if (hoverSection != -1) {
+        viewport()->update(cellRect(hoverSection, hoverIndex));
+    }
+    if (hoverIcon) {
+        hoverIcon->stop();
+        delete hoverIcon;
+        hoverIcon = nullptr;
+    }
+
+    hoverSection = section;
+    hoverIndex   = index;
+    if (section == -1) {
+        return;
+    }
+
+    hoverIcon = new PsiIcon(*sections[section].icons[index]);
+    connect(hoverIcon, SIGNAL(pixmapChanged()), SLOT(hoverIconUpdated()));
+    hoverIcon->activated(false);
+    viewport()->update(cellRect(section, index));
+}
+
+void IconSelect::hoverIconUpdated()
+{
+    if (hoverSection != -1) {
+        viewport()->update(cellRect(hoverSection, hoverIndex));
+    }
+}
+
+void IconSelect::moveHover(int delta)
+{
+    int section = hoverSection;
+    int index   = hoverIndex;
+    if (section == -1) {
+        if (sections.isEmpty() || sections.first().icons.isEmpty()) {
+            return;
+        }
+        setHovered(0, 0);
+        return;
+    }
+
+    index += delta;
+    while (index < 0 && section > 0) {
+        index += sections[--section].icons.count();
+    }
+    while (index >= sections[section].icons.count() && section < sections.count() - 1) {
+        index -= sections[section++].icons.count();
+    }
+    if (sections[section].icons.isEmpty()) {
+        return;
+    }
+    setHovered(section, qBound(0, index, sections[section].icons.count() - 1));
+
+    // keep the keyboard selection visible
+    QRect r = cellRect(hoverSection, hoverIndex);
+    if (r.top() < 0) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() + r.top());
+    } else if (r.bottom() >= viewport()->height()) {
+        verticalScrollBar()->setValue(verticalScrollBar()->value() + r.bottom() - viewport()->height() + 1);
+    }
+}
+
+void IconSelect::select(const PsiIcon *icon)
+{
+    recent.removeAll(icon->name());
+    recent.prepend(icon->name());
+    while (recent.count() > columns) {
+        recent.removeLast();
+    }
+
+    // the icon may go away with the sections, and then the menu is closed
+    PsiIcon copy(*icon);
+    if (filter.isEmpty()) {
+        buildSections();
+    }
+    emit menu->iconSelected(&copy);
+    emit menu->textSelected(copy.defaultText());
+}
+
+void IconSelect::paintEvent(QPaintEvent *e)
+{
+    QPainter p(viewport());
+
+    QStyleOptionMenuItem opt;
+    opt.palette = palette();
+    opt.rect    = viewport()->rect();
+    style()->drawControl(QStyle::CE_MenuEmptyArea, &opt, &p, this);
+
+    if (!is.count()) {
+        p.drawText(viewport()->rect(), Qt::AlignCenter, noIconsText());
+        return;
+    }
+
+    const int offset  = verticalScrollBar()->value();
+    const int visTop  = e->rect().top() + offset;
+    const int visBott = e->rect().bottom() + offset;
+
+    for (int i = 0; i < sections.count(); ++i) {
+        const Section &s = sections[i];
+        if (s.top > visBott) {
+            break;
+        }
+
+        int y = s.top;
+        if (!s.name.isEmpty()) {
+            QRect header(margin, y - offset, columns * tileSize, headerHeight);
+            p.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+            p.drawText(header, Qt::AlignLeft | Qt::AlignVCenter, s.name);
+            y += headerHeight;
+        }
+
+        const int rows     = (s.icons.count() + columns - 1) / columns;
+        const int firstRow = qMax(0, (visTop - y) / tileSize);
+        const int lastRow  = qMin(rows - 1, (visBott - y) / tileSize);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                const int index = row * columns + column;
+                if (index >= s.icons.count()) {
+                    break;
+                }
+
+                QRect          r       = cellRect(i, index);
+                const bool     hovered = (i == hoverSection && index == hoverIndex);
+                const PsiIcon *icon    = hovered && hoverIcon ? hoverIcon : s.icons[index];
+                if (hovered) {
+                    QStyleOptionMenuItem itemOpt;
+                    itemOpt.palette = palette();
+                    itemOpt.state   = QStyle::State_Active | QStyle::State_Enabled | QStyle::State_Selected;
+                    itemOpt.font    = font();
+                    itemOpt.rect    = r;
+                    style()->drawControl(QStyle::CE_MenuItem, &itemOpt, &p, this);
+                }
+
+                QPixmap pix = icon->pixmap(maxIconSize);
+                qreal   dpr = pix.devicePixelRatio();
+                if (pix.width() > maxIconSize.width() * dpr || pix.height() > maxIconSize.height() * dpr) {
+                    pix = pix.scaled(maxIconSize * dpr, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                    pix.setDevicePixelRatio(dpr);
+                }
+                QSize size = pix.size() / dpr;
+                p.drawPixmap(r.x() + (r.width() - size.width()) / 2, r.y() + (r.height() - size.height()) / 2, pix);
+            }
+        }
+    }
+}
+
+void IconSelect::resizeEvent(QResizeEvent *e)
+{
+    QAbstractScrollArea::resizeEvent(e);
+    relayout();
+}
+
+void IconSelect::mouseMoveEvent(QMouseEvent *e)
+{
+    int section, index;
+    if (itemAt(e->pos(), &section, &index)) {
+        setHovered(section, index);
+    } else {
+        setHovered(-1, -1);
+    }
+}
+
+void IconSelect::mouseReleaseEvent(QMouseEvent *e)
+{
+    int section, index;
+    if (e->button() == Qt::LeftButton && itemAt(e->pos(), &section, &index)) {
+        select(sections[section].icons[index]);
+    }
+}
+
+void IconSelect::leaveEvent(QEvent *) { setHovered(-1, -1); }
+
+void IconSelect::keyPressEvent(QKeyEvent *e)
+{
+    switch (e->key()) {
+    case Qt::Key_Left:
+        moveHover(-1);
+        break;
+    case Qt::Key_Right:
+        moveHover(1);
+        break;
+    case Qt::Key_Up:
+        moveHover(-columns);
+        break;
+    case Qt::Key_Down:
+        moveHover(columns);
+        break;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        if (hoverSection != -1) {
+            select(sections[hoverSection].icons[hoverIndex]);
+        }
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(e);
+        return;
+    }
+    e->accept();
+}
+
+bool IconSelect::viewportEvent(QEvent *e)
+{
+    if (e->type() == QEvent::ToolTip) {
+        QHelpEvent *he = static_cast<QHelpEvent *>(e);
+        int         section, index;
+        if (itemAt(he->pos(), &section, &index)) {
+            // list of possible variants in the ToolTip
+            QStringList toolTip;
+            for (const PsiIcon::IconText &t : sections[section].icons[index]->text()) {
+                toolTip += t.text;
+            }
+
+            QString toolTipText = toolTip.join(", ");
+            if (toolTipText.length() > 30)
+                toolTipText = toolTipText.left(30) + "...";
+
+            PsiToolTip::showText(he->globalPos(), toolTipText, viewport());
+        }
+        return true;
+    }
+    return QAbstractScrollArea::viewportEvent(e);
+}
+//! \endif
+
 //----------------------------------------------------------------------------
 // IconSelectPopup
 //----------------------------------------------------------------------------
@@ -408,22 +644,67 @@ public:
     IconSelectPopup *parent_;
     IconSelect *     icsel_;
     QWidgetAction *  widgetAction_;
-    QScrollArea *    scrollArea_;
+    QWidget *        container_;
+    QLineEdit *      search_;
+    QWidget *        categoryBar_;
+
+    // keys which make sense for the grid are passed on, so the icons can be picked without leaving the search
+    bool eventFilter(QObject *watched, QEvent *e)
+    {
+        if (watched == search_ && e->type() == QEvent::KeyPress) {
+            switch (static_cast<QKeyEvent *>(e)->key()) {
+            case Qt::Key_Up:
+            case Qt::Key_Down:
+            case Qt::Key_PageUp:
+            case Qt::Key_PageDown:
+            case Qt::Key_Return:
+            case Qt::Key_Enter:
+                QCoreApplication::sendEvent(icsel_, e);
+                return true;
+            default:
+                break;
+            }
+        }
+        return QObject::eventFilter(watched, e);
+    }
 
 public slots:
     void updatedGeometry()
     {
-        widgetAction_->setDefaultWidget(scrollArea_);
-        QRect r       = QApplication::desktop()->availableGeometry(scrollArea_);
-        int   maxSize = qMin(r.width(), r.height()) / 3;
-        int   vBarWidth
-            = scrollArea_->verticalScrollBar()->isEnabled() ? scrollArea_->verticalScrollBar()->sizeHint().rwidth() : 0;
-        scrollArea_->setMinimumWidth(icsel_->sizeHint().rwidth() + vBarWidth);
-        scrollArea_->setMinimumHeight(qMin(icsel_->sizeHint().rheight(), maxSize));
-        scrollArea_->setFrameStyle(QFrame::Plain);
+        widgetAction_->setDefaultWidget(container_);
+        QRect r         = QApplication::desktop()->availableGeometry(container_);
+        int   maxSize   = qMin(r.width(), r.height()) / 3;
+        int   vBarWidth = icsel_->sizeHint().rheight() > maxSize ? icsel_->verticalScrollBar()->sizeHint().rwidth() : 0;
+        icsel_->setMinimumWidth(icsel_->sizeHint().rwidth() + vBarWidth);
+        icsel_->setMinimumHeight(qMin(icsel_->sizeHint().rheight(), maxSize));
         parent_->removeAction(widgetAction_);
         parent_->addAction(widgetAction_);
     }
+
+    void updateCategories()
+    {
+        qDeleteAll(categoryBar_->findChildren<QToolButton *>(QString(), Qt::FindDirectChildren));
+
+        QStringList names = icsel_->categoryNames();
+        for (const QString &name : names) {
+            QToolButton *button = new QToolButton(categoryBar_);
+            button->setAutoRaise(true);
+            button->setToolTip(name);
+            button->setText(name.left(1));
+            for (const IconSelect::Section &section : icsel_->categories()) {
+                if (section.name == name && !section.icons.isEmpty()) {
+                    button->setIcon(section.icons.first()->icon());
+                    break;
+                }
+            }
+            connect(button, &QToolButton::clicked, this, [this, name]() {
+                search_->clear();
+                icsel_->scrollToSection(name);
+            });
+            categoryBar_->layout()->addWidget(button);
+        }
+        categoryBar_->setVisible(names.count() > 1);
+    }
 };
 
 IconSelectPopup::IconSelectPopup(QWidget *parent) : QMenu(parent)
@@ -431,12 +712,35 @@ IconSelectPopup::IconSelectPopup(QWidget *parent) : QMenu(parent)
     d                = new Private(this);
     d->icsel_        = new IconSelect(this);
     d->widgetAction_ = new QWidgetAction(this);
-    d->scrollArea_   = new QScrollArea(this);
-    d->scrollArea_->setWidget(d->icsel_);
-    d->scrollArea_->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    d->scrollArea_->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    d->scrollArea_->setWidgetResizable(true);
+    d->container_    = new QWidget(this);
+    d->search_       = new QLineEdit(d->container_);
+    d->categoryBar_  = new QWidget(d->container_);
+
+    d->search_->setPlaceholderText(tr("Search"));
+    d->search_->setClearButtonEnabled(true);
+    d->search_->installEventFilter(d);
+    connect(d->search_, &QLineEdit::textChanged, d->icsel_, &IconSelect::setFilter);
+
+    QHBoxLayout *categoryLayout = new QHBoxLayout(d->categoryBar_);
+    categoryLayout->setMargin(0);
+    categoryLayout->setSpacing(0);
+    categoryLayout->setAlignment(Qt::AlignLeft);
+
+    QVBoxLayout *layout = new QVBoxLayout(d->container_);
+    layout->setMargin(style()->pixelMetric(QStyle::PM_MenuPanelWidth, nullptr, this));
+    layout->setSpacing(1);
+    layout->addWidget(d->search_);
+    layout->addWidget(d->categoryBar_);
+    layout->addWidget(d->icsel_);
+
     connect(d->icsel_, &IconSelect::updatedGeometry, d, &IconSelectPopup::Private::updatedGeometry);
+    connect(d->icsel_, &IconSelect::sectionsChanged, d, &IconSelectPopup::Private::updateCategories);
+    connect(this, &QMenu::aboutToShow, d, [this]() {
+        d->search_->clear();
+        d->search_->setFocus();
+        d->updateCategories(); // the recently used section may have appeared
+    });
+    d->updateCategories();
     d->updatedGeometry();
 }
 
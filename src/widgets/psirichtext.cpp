@@ -22,6 +22,7 @@
 
 #include <QAbstractTextDocumentLayout> // for QTextObjectInterface
 #include <QApplication>
+#include <QCache>
 #include <QCryptographicHash>
 #include <QFileInfo>
 #include <QFont>
@@ -53,6 +54,9 @@ static const int   IconFormatType   = QTextFormat::UserObject;
 static const int   MarkerFormatType = QTextFormat::UserObject + 1;
 static QStringList allowedImageDirs;
 
+static const char *documentCacheProperty = "psiDocumentCache";
+static const int   documentCacheSize     = 2048; // KiB of rendered objects kept per document
+
 //----------------------------------------------------------------------------
 // TextIconFormat
 //----------------------------------------------------------------------------
@@ -82,6 +86,82 @@ TextIconFormat::TextIconFormat(const QString &iconName, const QString &text, qre
     // TODO: handle animations
 }
 
+//----------------------------------------------------------------------------
+// DocumentCache
+//----------------------------------------------------------------------------
+
+/**
+ * Keeps pixmaps of inline icons and decoded data: images of a document,
+ * so repaints and repeated images don't go to the iconset or image decoders.
+ * It's a child of the document so it's freed together with it.
+ */
+class DocumentCache : public QObject {
+public:
+    static DocumentCache *instance(QTextDocument *doc)
+    {
+        auto cache = static_cast<DocumentCache *>(doc->property(documentCacheProperty).value<QObject *>());
+        if (!cache) {
+            cache = new DocumentCache(doc);
+            doc->setProperty(documentCacheProperty, QVariant::fromValue<QObject *>(cache));
+        }
+        return cache;
+    }
+
+#ifndef WIDGET_PLUGIN
+    QPixmap iconPixmap(const QString &iconName, const QSize &size)
+    {
+        // the icon is checked to notice iconset changes. it's just a lookup by name
+        const PsiIcon *icon = IconsetFactory::iconPtr(iconName);
+        const QString  key  = iconName + QLatin1Char('\n') + QString::number(size.width()) + QLatin1Char('x')
+            + QString::number(size.height());
+        IconEntry *entry = icons.object(key);
+        if (entry && entry->icon == icon) {
+            return entry->pixmap;
+        }
+
+        QPixmap pixmap = IconsetFactory::iconPixmap(iconName, size);
+        qreal   dpr    = pixmap.devicePixelRatio(); // rendered for the screen, keep the extra pixels
+        if (pixmap.size() != size * dpr) {
+            pixmap = pixmap.scaled(size * dpr, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            pixmap.setDevicePixelRatio(dpr);
+        }
+        icons.insert(key, new IconEntry { icon, pixmap }, cost(pixmap.size()));
+        return pixmap;
+    }
+#endif
+
+    QImage dataImage(const QByteArray &hash) const
+    {
+        QImage *image = dataImages.object(hash);
+        return image ? *image : QImage();
+    }
+
+    void addDataImage(const QByteArray &hash, const QImage &image)
+    {
+        dataImages.insert(hash, new QImage(image), cost(image.size()));
+    }
+
+private:
+    DocumentCache(QTextDocument *doc) : QObject(doc)
+    {
+        dataImages.setMaxCost(documentCacheSize);
+#ifndef WIDGET_PLUGIN
+        icons.setMaxCost(documentCacheSize);
+#endif
+    }
+
+    static int cost(const QSize &size) { return qMax(1, size.width() * size.height() * 4 / 1024); }
+
+#ifndef WIDGET_PLUGIN
+    struct IconEntry {
+        const PsiIcon *icon;
+        QPixmap        pixmap;
+    };
+    QCache<QString, IconEntry> icons;
+#endif
+    QCache<QByteArray, QImage> dataImages; // by sha1 of base64 encoded data
+};
+
 //----------------------------------------------------------------------------
 // IconTextObjectInterface
 //----------------------------------------------------------------------------
@@ -143,7 +223,6 @@ QSizeF TextIconHandler::intrinsicSize(QTextDocument *doc, int posInDocument, con
 void TextIconHandler::drawObject(QPainter *painter, const QRectF &rect, QTextDocument *doc, int posInDocument,
                                  const QTextFormat &format)
 {
-    Q_UNUSED(doc);
     Q_UNUSED(posInDocument);
 
     const QTextCharFormat charFormat = format.toCharFormat();
@@ -154,13 +233,8 @@ void TextIconHandler::drawObject(QPainter *painter, const QRectF &rect, QTextDoc
         return;
     }
 
-    auto pixmap = IconsetFactory::iconPixmap(iconName, rect.size().toSize());
-    if (rect.size() == pixmap.size()) {
-        painter->drawPixmap(rect, pixmap, pixmap.rect());
-    }
-
-    auto sp = pixmap.scaled(rect.size().toSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    painter->drawPixmap(rect, sp, sp.rect());
+    auto pixmap = DocumentCache::instance(doc)->iconPixmap(iconName, rect.size().toSize());
+    painter->drawPixmap(rect, pixmap, pixmap.rect());
 }
 #endif // WIDGET_PLUGIN
 
@@ -424,14 +498,21 @@ static void appendTextHelper(QTextDocument *doc, QString text, QTextCursor &curs
             if (imgSrcUrl.scheme() == "data") {
                 static QRegExp dataRe("^[a-zA-Z]+/[a-zA-Z]+;base64,([a-zA-Z0-9/=+%]+)$");
                 if (dataRe.indexIn(imgSrcUrl.path()) != -1) {
-                    const QByteArray ba = QByteArray::fromBase64(dataRe.cap(1).toLatin1());
-                    if (!ba.isNull()) {
-                        QImage image;
-                        if (image.loadFromData(ba)) {
-                            replace = "srcdata" + QCryptographicHash::hash(ba, QCryptographicHash::Sha1).toHex();
-                            doc->addResource(QTextDocument::ImageResource, QUrl(replace), image);
+                    // the same images (e.g. avatars) come again and again. decode each only once
+                    const QByteArray data  = dataRe.cap(1).toLatin1();
+                    const QByteArray hash  = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+                    auto             cache = DocumentCache::instance(doc);
+                    QImage           image = cache->dataImage(hash);
+                    if (image.isNull()) {
+                        const QByteArray ba = QByteArray::fromBase64(data);
+                        if (!ba.isNull() && image.loadFromData(ba)) {
+                            cache->addDataImage(hash, image);
                         }
                     }
+                    if (!image.isNull()) {
+                        replace = "srcdata" + hash.toHex();
+                        doc->addResource(QTextDocument::ImageResource, QUrl(replace), image);
+                    }
                 }
             } else if (imgSrc.startsWith(":/") || (!imgSrcUrl.scheme().isEmpty() && imgSrcUrl.scheme() != "file")) {
                 pos += imgRe.matchedLength();
@@ -593,6 +674,13 @@ void PsiRichText::insertMarker(QTextCursor &cursor, const QString &uniqueId)
     cursor.insertText(QString(QChar::ObjectReplacementCharacter), TextMarkerFormat(uniqueId));
 }
 
+// checks if the character before the cursor is the marker with given id
+bool PsiRichText::isMarker(const QTextCursor &cursor, const QString &uniqueId)
+{
+    QTextCharFormat format = cursor.charFormat();
+    return format.objectType() == MarkerFormatType && format.stringProperty(TextMarkerFormat::MarkerId) == uniqueId;
+}
+
 // returns cursor with selection on marker
 QTextCursor PsiRichText::findMarker(const QTextCursor &cursor, const QString &uniqueId)
 {
@@ -601,8 +689,7 @@ QTextCursor PsiRichText::findMarker(const QTextCursor &cursor, const QString &un
     QTextCursor nc     = doc->find(obrepl, cursor);
 
     while (!nc.isNull()) {
-        if (nc.charFormat().objectType() == MarkerFormatType
-            && nc.charFormat().stringProperty(TextMarkerFormat::MarkerId) == uniqueId) {
+        if (isMarker(nc, uniqueId)) {
             break;
         }
         nc = doc->find(obrepl, nc);
@@ -337,6 +337,7 @@ function psiThemeAdapter(chat) {
         };
 
         shared.session.newMessage.connect(chat.receiveObject);
+        shared.session.newMessages.connect(chat.receiveObjects);
         shared.session.scrollRequested.connect((value) => {
                                                    if (shared.scroller && shared.scroller.cancel)
                                                        shared.scroller.cancel();
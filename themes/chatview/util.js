@@ -803,6 +803,26 @@ function initPsiTheme() {
             }
 
             chat.adapter.receiveObject(data)
+        },
+
+        // a batch of objects from newMessages signal. the next batch comes only after we report
+        // this one is processed, so acknowledge it with the next frame when layout is done.
+        // a failed object must not stop the acknowledgement, or no more messages would come.
+        // hidden pages get no frames, so they acknowledge right away.
+        receiveObjects : function(list) {
+            for (var i = 0; i < list.length; i++) {
+                try {
+                    chat.receiveObject(list[i]);
+                } catch(e) {
+                    server.console("Failed to receive object: " + e);
+                }
+            }
+            var ack = function() { session.messagesProcessed(); };
+            if (document.hidden) {
+                setTimeout(ack, 0);
+            } else {
+                requestAnimationFrame(ack);
+            }
         }
     }
 